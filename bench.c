@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <string.h>
+
+#include "dmm.h"
+#include "workload.h"
+
+/*
+ * Runs one generated workload against the heap manager, e.g.
+ *   ./bench --size lognormal:256:1.5 --lifetime exp:2000 --policy first-fit
+ * With no arguments it replays test_stress2. DMALLOC_BACKEND in the
+ * environment picks the allocator to measure; with DMALLOC_LOCK_STATS=1 it
+ * also prints the lock statistics.
+ */
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [options]\n", prog);
+	fprintf(stderr, "  --policy P         adaptive, first-fit, segregated or address-ordered (adaptive)\n");
+	workload_usage(stderr);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	workload_t wl;
+	wl_result_t result;
+	dmalloc_lock_stats_t arena_locks, class_locks;
+	int i, n;
+
+	workload_defaults(&wl);
+
+	for(i = 1; i < argc; i += n)
+	{
+		n = workload_parse_arg(&wl, argc, argv, i);
+		if(n > 0)
+			continue;
+		if(n == 0 && strcmp(argv[i], "--policy") == 0 && i + 1 < argc)
+		{
+			if(strcmp(argv[i + 1], "adaptive") == 0)
+				dmalloc_set_policy(DMM_POLICY_ADAPTIVE);
+			else if(strcmp(argv[i + 1], "first-fit") == 0)
+				dmalloc_set_policy(DMM_POLICY_FIRST_FIT);
+			else if(strcmp(argv[i + 1], "segregated") == 0)
+				dmalloc_set_policy(DMM_POLICY_SEGREGATED);
+			else if(strcmp(argv[i + 1], "address-ordered") == 0)
+				dmalloc_set_policy(DMM_POLICY_ADDRESS_ORDERED);
+			else
+				usage(argv[0]);
+			n = 2;
+			continue;
+		}
+		usage(argv[0]);
+	}
+
+	if(!workload_run(&wl, &result))
+	{
+		fprintf(stderr, "could not set up the workload\n");
+		exit(1);
+	}
+
+	printf("Workload summary (%s backend)\n", dmalloc_backend());
+	workload_print(stdout, &wl, &result);
+
+	if(getenv("DMALLOC_LOCK_STATS") == NULL)
+		return 0;
+	dmalloc_lock_stats(&arena_locks, &class_locks);
+	printf("arena locks: %lu acquired, %lu contended, %.3f ms waiting, %.3f ms held\n",
+	       arena_locks.acquired, arena_locks.contended, arena_locks.wait_ns / 1e6, arena_locks.hold_ns / 1e6);
+	printf("class locks: %lu acquired, %lu contended, %.3f ms waiting, %.3f ms held\n",
+	       class_locks.acquired, class_locks.contended, class_locks.wait_ns / 1e6, class_locks.hold_ns / 1e6);
+	return 0;
+}
@@ -1,7 +1,24 @@
+#define _GNU_SOURCE //for getcpu
 #include <stdio.h> //needed for size_t
-#include <unistd.h> //needed for sbrk
+#include <stdlib.h> //for getenv
+#include <unistd.h> //for sysconf
 #include <assert.h> //For asserts
+#include <pthread.h> //for the arena locks
+#include <sched.h> //for getcpu
+#include <string.h> //for strcmp
+#include <time.h> //for the lock statistics
+#include <sys/mman.h> //for the mmap'ed arenas and madvise
+#include <sys/syscall.h> //for mbind
+#include <sys/random.h> //for getrandom
 #include "dmm.h"
+#include "dmm_prof.h"
+#include "dmm_trace.h"
+#include "dmm_percpu.h"
+#include "dmm_backend.h"
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1 /* from <numaif.h>, without depending on libnuma */
+#endif
 
 /*
 
@@ -170,10 +187,19 @@ typedef struct footer {
     
 } footer_t;
 
-void coalesce(metadata_t* ptr);
-
 #define FOOTER_T_ALIGNED (ALIGN(sizeof(footer_t)))
 
+/*
+ Payloads are DMALLOC_ALIGNMENT aligned, as malloc's are. A header and a
+ footer together take a multiple of DMALLOC_ALIGNMENT bytes, so if the first
+ block's payload is aligned and every payload size is rounded up to it, all
+ later payloads are aligned too. REGION_PAD bytes at the start of each region
+ put the first payload there; a->head is the first block, after the pad.
+ */
+#define REGION_PAD ((DMALLOC_ALIGNMENT - METADATA_T_ALIGNED % DMALLOC_ALIGNMENT) % DMALLOC_ALIGNMENT)
+
+_Static_assert((METADATA_T_ALIGNED + FOOTER_T_ALIGNED) % DMALLOC_ALIGNMENT == 0, "header and footer must keep payloads aligned");
+
 /*since size is always a multiple of 8, we can use the last one bit in its binary
  representation to denote whether this block is used or not
  0 : unused
@@ -182,262 +208,2467 @@ void coalesce(metadata_t* ptr);
 #define TO_USED(ptr) (ptr->size = (ptr->size | 0x1)) 
 #define TO_UNUSED(ptr) ( ptr->size = (ptr->size & (~0x7)) )
 
-static metadata_t* freelist = NULL;
-static metadata_t* head = NULL; //this pointer will always point to the beginning of the sbrk call, where no footer is in front of it
-static metadata_t* tail = NULL; // this points to the tail of the whole memory block
+/* the second bit marks a used block whose pointer the heap profiler sampled;
+ TO_UNUSED clears it together with the used bit */
+#define TO_SAMPLED(ptr) (ptr->size = (ptr->size | 0x2))
+#define IS_SAMPLED(ptr) (ptr->size & 0x2)
 
-void* dmalloc(size_t numbytes) {
+/* the third bit marks a used block the program has freed but the heap has not
+ yet: it is parked in a CPU cache, on a class list or on a remote free stack.
+ Together with the used bit it lets dfree recognize a double free in O(1). */
+#define TO_PARKED(ptr) (ptr->size = (ptr->size | 0x4))
+#define TO_UNPARKED(ptr) (ptr->size = (ptr->size & (~0x4)))
+#define IS_PARKED(ptr) (ptr->size & 0x4)
+
+/*
+ Integrity checks. With DMALLOC_CHECK=1 every used block carries a keyed
+ checksum of its address, size and used bit in metadata_t.prev, which only
+ free blocks need otherwise. dfree verifies the checksum and the footer
+ before it trusts the size, and coalesce verifies the boundary tags of every
+ neighbour it looks at, so a header overwritten by an overflow is reported
+ where it is first seen instead of sending coalesce off through a garbage
+ size. The key is drawn at startup, so a stray write cannot produce a valid
+ checksum except by chance. The sampled and parked bits are left out: they
+ change after the block is sealed.
+ */
+static bool integrity_checks = false;
+static size_t integrity_key;
+
+static size_t checksum(metadata_t* block) {
     
-    //Initialize freelist through sbrk call first time
+    size_t x = (((size_t) block) ^ (block->size & (~0x6))) * integrity_key;
     
-    if(freelist == NULL) {
-        if(!dmalloc_init()) {
-            return NULL;  //if freelist is successfully initiated, won't return NULL
-        }
-    }
+    return x ^ (x >> 29);
+}
+
+#define SEAL(ptr) (integrity_checks ? (ptr->prev = (metadata_t*) checksum(ptr)) : NULL)
+
+__attribute__((noreturn, cold))
+void dmm_heap_abort(const char* what, void* block) {
     
-    //after the first time, freelist will not be null, code goes here:
+    char msg[128];
     
-    assert(numbytes > 0);
+    //no stdio streams: they may allocate, and the heap is not to be trusted
     
-    /* Your code goes here */
+    int len = snprintf(msg, sizeof(msg), "dmalloc: %s at %p\n", what, block);
     
-    size_t numbytes_aligned = ALIGN(numbytes); //align the requested numbytes
+    if (write(STDERR_FILENO, msg, (len < (int) sizeof(msg)) ? len : (int) sizeof(msg) - 1) < 0) {
+        //nothing left to report it to
+    }
     
-    metadata_t* cur_freelist = freelist; //set the current ptr to the head of the freelist and start iteration
-        
+    abort();
+}
+
+static void verify_used(metadata_t* block) {
     
-    size_t requiredSpace = (numbytes_aligned + FOOTER_T_ALIGNED + METADATA_T_ALIGNED);
+    footer_t* footer = (footer_t*) (((void*) block) + METADATA_T_ALIGNED + (block->size & (~0x7)));
+    
+    if ((size_t) block->prev != checksum(block)) {
+        dmm_heap_abort("heap corruption: bad header checksum", block);
+    }
     
+    if ((footer->size & (~0x7)) != (block->size & (~0x7))) {
+        dmm_heap_abort("heap corruption: footer does not match the header", block);
+    }
+}
 
-    while ((cur_freelist->size) < requiredSpace ) { //move the cur_freelist ptr to the start of the block with enough size 
+/*
+ Adaptive lookup policy. Every dmalloc feeds the number of free blocks it
+ inspected into a moving average. Once that average exceeds SEARCH_HIGH the
+ free blocks are redistributed into segregated bins, one per power of two, and
+ searches only touch the bins that can hold the request. When the number of
+ free blocks drops to SHORT_LIST again we go back to the single list.
+ */
+#ifndef SEARCH_HIGH
+#define SEARCH_HIGH 32
+#endif
+#ifndef SHORT_LIST
+#define SHORT_LIST 8
+#endif
+#define SEARCH_AVG_SHIFT 4 /* the average weighs the newest search by 1/16 */
+#define NBINS 32
 
-        if ((cur_freelist->next) == NULL){
-            return NULL; //not enough space in freelist
-        }else {
-            cur_freelist = cur_freelist->next;
-            
-        }
-    }
-   
-    // SPLIT step 1: Create footer for the block we're allocating
+/*
+ Address-ordered first-fit. With DMM_POLICY_ADDRESS_ORDERED the single free
+ list is kept sorted by address, so first-fit settles on the lowest block
+ that fits and the top of the arena stays in one piece. To find a freed
+ block's place without walking the list, the arena then keeps an index: a
+ bitmap with one bit per ALIGNMENT bytes of its region, set where a free
+ block starts, under a summary bitmap with one bit per word of it, and so on
+ up to a single word. The nearest free block below an address takes one step
+ up and one step down per level, O(log64 of the region size). The index is
+ mapped with MAP_NORESERVE, so only the words that ever get set cost memory.
+ */
+#define INDEX_LEVELS 8
 
-    footer_t* new_footer = (footer_t*) (((void*)cur_freelist) + METADATA_T_ALIGNED + numbytes_aligned);
+/*
+ Prefetching. The first-fit walk and coalesce are chains of dependent loads,
+ each likely a cache miss on a large heap. The walk asks for the header of the
+ next candidate while it is still comparing the current one; coalesce looks up
+ both neighbours before merging either, so the misses on them and on their
+ free list neighbours overlap; and a split or free asks for the far end of
+ the block, where its footer goes, up front. Build with -DDMM_PREFETCH=0 to
+ compare, see bench-prefetch in the Makefile.
+ */
+#ifndef DMM_PREFETCH
+#define DMM_PREFETCH 1
+#endif
+#if DMM_PREFETCH
+#define PREFETCH(addr) __builtin_prefetch((addr), 1, 3)
+#else
+#define PREFETCH(addr) ((void) (addr))
+#endif
+
+/*
+ NUMA arenas. Every NUMA node gets its own arena: a heap region with its own
+ free lists and lock, and threads allocate from the arena of the node they are
+ running on. With a single node (or DMALLOC_NUMA=0 in the environment) there
+ is one arena. With several nodes each arena's region is bound to its node
+ with mbind before anything touches it.
+
+ Lazy commit. An arena's region is only reserved up front, as a PROT_NONE
+ mapping that costs neither memory nor commit charge, so MAX_HEAP_SIZE can be
+ large. The pages are made accessible in COMMIT_CHUNK steps as splitting
+ advances into untouched space; the region stays one contiguous range, so
+ boundary tags and coalescing work as before. committed marks the end of the
+ accessible part, apart from the last page, which holds the end footer.
+
+ Threads. All state of an arena is protected by its lock. The thread that
+ initialized the arena owns it; when any other thread frees a block, be it a
+ thread on the same node or a remote one, it does not take the lock but
+ pushes the block onto the arena's remote_frees, a lock-free stack threaded
+ through metadata_t.next. So blocks always go back to their home arena. The
+ next dmalloc on that arena detaches the whole stack with one atomic exchange
+ and frees the blocks in a batch. Until then the blocks keep their used bit,
+ so coalesce never looks at their next field.
+ */
+#ifndef MAX_NODES
+#define MAX_NODES 8
+#endif
+
+/*
+ Huge pages. DMALLOC_HUGEPAGES=thp maps every arena 2 MiB aligned and asks for
+ transparent huge pages with MADV_HUGEPAGE; DMALLOC_HUGEPAGES=hugetlb maps it
+ from the hugetlbfs pool with MAP_HUGETLB and falls back to thp when the pool
+ is empty. Lazily committed regions then commit whole huge pages at a time,
+ and dmalloc_purge only returns whole huge pages to the kernel, so neither
+ breaks a huge page up into small ones. hugetlbfs memory is committed at once.
+ */
+#define HUGE_PAGE_SIZE (2UL*1024*1024)
+
+#ifndef COMMIT_CHUNK
+#define COMMIT_CHUNK (64*1024)
+#endif
+
+typedef enum {PAGES_SMALL, PAGES_THP, PAGES_HUGETLB} page_mode_t;
+
+/*
+ Per-CPU caches. With DMALLOC_PERCPU=1, requests of up to SMALL_MAX_SIZE
+ bytes are rounded up to a multiple of 16 and served from a stack of free
+ blocks kept per CPU and size class (see dmm_percpu.c), without locks. An
+ empty stack is refilled with a batch carved from the arena under its lock;
+ a full one flushes half of its blocks back through the normal dfree path.
+ Cached blocks count as used for coalescing and dmalloc_walk, and their
+ memory is bounded by the number of CPUs rather than threads. When an arena
+ runs dry dmalloc flushes the calling CPU's cache and tries again.
+ */
+#define PERCPU_BATCH 8
+
+/*
+ Size-class locks. With DMALLOC_CLASS_LOCKS=1 every arena also keeps a list
+ of free blocks per small size class, each behind its own lock, so threads
+ allocating or freeing different classes no longer queue on the arena lock.
+ The arena lock then only guards the general free lists, i.e. large blocks,
+ splitting, coalescing and committing more of the region. A class list is
+ stocked CLASS_BATCH blocks at a time and spills back to the arena when it
+ grows past CLASS_LIST_MAX blocks; an arena that runs dry empties the lists.
+
+ Lock order: a class lock is never held while taking the arena lock or
+ another class lock, and the arena lock never while taking a class lock;
+ blocks move between the two in detached batches. Only the fork handlers
+ hold them together, taking the arena lock and then the class locks in
+ index order. Blocks on a class list keep their used bit, so coalesce, which
+ runs under the arena lock, never merges with them.
+ */
+#define CLASS_BATCH 8
+#define CLASS_LIST_MAX 64
+
+/*
+ Locks with statistics. Every acquisition is counted; one that finds the
+ lock taken also counts as contended and adds the time it waited. Hold
+ times cost two clock reads per acquisition, so they are only measured with
+ DMALLOC_LOCK_STATS=1.
+ */
+typedef struct dmm_lock {
+    pthread_mutex_t mutex;
+    unsigned long acquired;
+    unsigned long contended;
+    unsigned long long wait_ns;
+    unsigned long long hold_ns;
+    unsigned long long held_since;
+} dmm_lock_t;
+
+static bool lock_timing = false;
+
+static unsigned long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void lock_acquire(dmm_lock_t* l) {
     
-    new_footer->size = numbytes_aligned;
+    if (pthread_mutex_trylock(&l->mutex) != 0) {
+        unsigned long long start = now_ns();
+        pthread_mutex_lock(&l->mutex);
+        l->contended++;
+        l->wait_ns += now_ns() - start;
+    }
     
-    TO_USED(new_footer);
+    l->acquired++;
     
-    // SPLIT step 2: Create metadata for the remaining free block
+    if (lock_timing) {
+        l->held_since = now_ns();
+    }
+}
 
-    metadata_t* new_freelist = (metadata_t*) (((void*)new_footer) + FOOTER_T_ALIGNED);
+static void lock_release(dmm_lock_t* l) {
+    
+    if (lock_timing) {
+        l->hold_ns += now_ns() - l->held_since;
+    }
     
-     
-    // SPLIT step 3: Remove the allocated block from the free list.
-    //Edge case: the first block in freelist is split.
+    pthread_mutex_unlock(&l->mutex);
+}
+
+typedef struct class_list {
+    dmm_lock_t lock;
+    metadata_t* blocks; // singly linked through next
+    size_t count;
+} class_list_t;
+
+/*
+ Quarantine. With DMALLOC_QUARANTINE=<bytes> a freed block does not go back
+ to its arena right away: its payload is filled with QUARANTINE_POISON and it
+ joins a FIFO of its heap, linked through metadata_t.next. Once the FIFO
+ holds more payload bytes than that, the oldest blocks leave it, and a block
+ whose poison changed in the meantime was written to after it was freed: we
+ abort. While in quarantine a block stays used and parked, so nothing reuses
+ or coalesces it and a second dfree still counts as a double free. A block
+ larger than half the quarantine bypasses it. The quarantine lock is never
+ held while taking another lock; blocks leaving are detached under it and
+ released after.
+ */
+#define QUARANTINE_POISON 0xdbdbdbdbdbdbdbdbUL
+
+typedef struct quarantine {
+    dmm_lock_t lock;
+    metadata_t* oldest;
+    metadata_t* newest;
+    size_t bytes; // payload bytes held
+} quarantine_t;
+
+/*
+ Deferred coalescing. With DMALLOC_DEFER=1 dfree leaves the block used and
+ parked and pushes it on its arena's deferred stack, the same lock-free push
+ as a remote free, and that is all. The blocks are coalesced in a batch, in
+ address order so each one merges into the block freed just before it, by
+ the next dmalloc that finds no fit in the arena, by dmalloc_coalesce, or,
+ with DMALLOC_DEFER_INTERVAL=<ms>, by a maintenance thread that wakes up that
+ often and also purges the pages of the blocks it merged. A tick with
+ nothing deferred since the last one takes no lock at all. The thread runs
+ until dmalloc_maintenance_stop or the end of the process. A forked child
+ has no maintenance thread; its arenas coalesce on the slow path only.
+ */
+
+typedef struct arena {
+    dmm_lock_t lock;
+    pthread_t owner;
+    metadata_t* remote_frees;
+    metadata_t* deferred; // freed but not yet coalesced, see DMALLOC_DEFER
     
-    new_freelist->prev = cur_freelist->prev;
-    new_freelist->next = cur_freelist->next;
+    metadata_t* freelist; // the single free list, used while segregated is false
+    metadata_t* head; //this pointer will always point to the beginning of the region, where no footer is in front of it
+    metadata_t* tail; // this points to the tail of the whole memory block
     
-    if (cur_freelist->prev != NULL) {
-        cur_freelist->prev->next = new_freelist;
-    }
+    metadata_t* bins[NBINS]; // segregated free lists, used while segregated is true
+    unsigned int bin_map; // bit i is set when bins[i] is non-empty
+    bool segregated;
+    bool ordered; // the single list is sorted by address, see index_below
+    unsigned long* index[INDEX_LEVELS]; // index[0] marks free block starts, index[l + 1] non-zero words of index[l]
+    int index_levels;
+    size_t index_bytes;
+    size_t free_blocks;
+    size_t search_avg; // scaled by 2^SEARCH_AVG_SHIFT
     
-    if (cur_freelist->next != NULL) {
-        cur_freelist->next->prev = new_freelist;
-    }
+    int node;
+    size_t page_size; // granularity dmalloc_purge works in
+    size_t region_bytes; // length of the mapping
+    void* committed; // the region is accessible below this address
+    size_t commit_chunk;
+    struct dheap* heap;
     
-    if (cur_freelist == freelist) { //this is the case when cur_freelist is pointing to the only metadata in the memory
+    class_list_t classes[SMALL_CLASSES];
+} arena_t;
 
-        new_freelist->next = cur_freelist->next;
-        new_freelist->prev = cur_freelist->prev;
-        
-        freelist = new_freelist;
-        
-    }
-       
-    //SPLIT step 4: fill in the metadata and the footer for the remaining free block
-    new_freelist->size = (cur_freelist->size) - numbytes_aligned - FOOTER_T_ALIGNED - METADATA_T_ALIGNED;
+/*
+ Heaps. A dheap_t is a set of arenas, one per node, with its own size and
+ lookup policy, so that components can keep their blocks apart. dmalloc and
+ dfree work on default_heap. Every heap made by dheap_create has its
+ descriptor mmap'ed as well, so dheap_destroy can hand all of it back at
+ once. The fork handlers find the heaps through the heaps list.
+ */
+struct dheap {
+    arena_t arenas[MAX_NODES];
+    size_t size; // bytes per arena
+    dmm_policy_t policy;
+    quarantine_t quarantine;
+    struct dheap* next;
+};
+
+static dheap_t default_heap;
+static dheap_t* heaps = &default_heap;
+static pthread_mutex_t heaps_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int nnodes = 1;
+static page_mode_t page_mode = PAGES_SMALL;
+static bool percpu_caches = false;
+static bool class_locks = false;
+static size_t quarantine_limit = 0; // bytes, 0 when there is no quarantine
+static bool defer_coalescing = false;
+static long maintenance_ms = 0; // 0 when there is no maintenance thread
+static bool deferred_pending = false; // some arena's deferred stack may be non-empty
+static pthread_mutex_t maintenance_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t maintenance_wake = PTHREAD_COND_INITIALIZER;
+static bool maintenance_running = false; // under maintenance_lock
+static pthread_t maintenance_thread;
+static pthread_once_t setup_once = PTHREAD_ONCE_INIT;
 
-    footer_t* footer_to_change = (footer_t*) (((void*) new_freelist) + METADATA_T_ALIGNED + (new_freelist->size));
+/*
+ Backends. DMALLOC_BACKEND=redo serves dmalloc and dfree from the sorted-list
+ allocator in dmm_redo.c instead of the heap in this file, so the same tests
+ and benchmarks run against either; see dmm_backend.h for what it covers.
+ */
+static bool heap_init();
+static void* heap_alloc(size_t numbytes);
+static void heap_free(void* ptr);
+static bool heap_owns(void* ptr);
+static size_t heap_usable_size(void* ptr);
+
+static const dmm_backend_t heap_backend = {
+    .name = "dmm",
+    .init = heap_init,
+    .alloc = heap_alloc,
+    .free = heap_free,
+    .owns = heap_owns,
+    .usable_size = heap_usable_size,
+};
+
+static const dmm_backend_t* const backends[] = { &heap_backend, &dmm_redo_backend };
+static const dmm_backend_t* backend = &heap_backend;
+
+metadata_t* coalesce(arena_t* a, metadata_t* ptr);
+
+/*
+ The highest node id in /sys/devices/system/node/online ("0", "0-1",
+ "0,2-3", ...) tells us how many arenas to keep.
+ */
+static int count_nodes() {
     
-    footer_to_change->size = new_freelist->size;
+    char* numa = getenv("DMALLOC_NUMA");
+    char buf[256];
+    int max_node = 0;
     
+    if (numa != NULL && numa[0] == '0') {
+        return 1;
+    }
     
-    cur_freelist->size = numbytes_aligned; //update the cur_freelist size
-    TO_USED(cur_freelist); //update the cur_freelist boolean
+    FILE* online = fopen("/sys/devices/system/node/online", "r");
+    if (online == NULL) {
+        return 1;
+    }
     
-    cur_freelist->next = NULL;
-    cur_freelist->prev = NULL;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, online);
+    fclose(online);
+    buf[n] = '\0';
     
+    char* p = buf;
+    while (*p != '\0') {
+        if (*p >= '0' && *p <= '9') {
+            int id = (int) strtol(p, &p, 10);
+            max_node = (id > max_node) ? id : max_node;
+        } else {
+            p++;
+        }
+    }
     
-    return (void*) ((void*)cur_freelist + METADATA_T_ALIGNED);
+    return (max_node < MAX_NODES) ? max_node + 1 : MAX_NODES;
+}
+
+static void init_heap(dheap_t* h, size_t size) {
+    
+    int i, cls;
+    
+    h->size = size;
+    h->policy = DMM_POLICY_ADAPTIVE;
     
+    for (i = 0; i < MAX_NODES; i++) {
+        pthread_mutex_init(&h->arenas[i].lock.mutex, NULL);
+        h->arenas[i].node = i;
+        h->arenas[i].heap = h;
+        
+        for (cls = 0; cls < SMALL_CLASSES; cls++) {
+            pthread_mutex_init(&h->arenas[i].classes[cls].lock.mutex, NULL);
+        }
+    }
+    
+    pthread_mutex_init(&h->quarantine.lock.mutex, NULL);
 }
 
-/*
-    In order to keep the dfree() under constant time, we move the to-free block to
-    the beginning of the free list. This operation doesn't involve looping 
-    through the freelist so it's O(1).
-*/
+static void* maintenance(void* arg);
 
-void dfree(void* ptr) {
+static void setup() {
     
-    //start moving to front
+    char* pages = getenv("DMALLOC_HUGEPAGES");
+    char* percpu = getenv("DMALLOC_PERCPU");
+    char* classes = getenv("DMALLOC_CLASS_LOCKS");
+    char* timing = getenv("DMALLOC_LOCK_STATS");
+    char* check = getenv("DMALLOC_CHECK");
+    char* quarantine = getenv("DMALLOC_QUARANTINE");
+    char* engine = getenv("DMALLOC_BACKEND");
+    char* defer = getenv("DMALLOC_DEFER");
+    char* interval = getenv("DMALLOC_DEFER_INTERVAL");
+    size_t i;
     
-    metadata_t* to_free_ptr = (metadata_t*) (((void*)ptr) - METADATA_T_ALIGNED);
+    nnodes = count_nodes();
+    
+    for (i = 0; engine != NULL && i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(engine, backends[i]->name) == 0) {
+            backend = backends[i];
+        }
+    }
+    
+    if (check != NULL && check[0] == '1') {
         
-    if (to_free_ptr != freelist) {
+        if (getrandom(&integrity_key, sizeof(integrity_key), GRND_NONBLOCK) != sizeof(integrity_key)) {
+            integrity_key = (size_t) time(NULL) ^ (size_t) &check;
+        }
         
-        to_free_ptr->next = freelist;
-        to_free_ptr->prev = NULL;
+        integrity_key |= 1; //odd, so the multiplication loses no bits
+        integrity_checks = true;
+    }
+    
+    class_locks = (classes != NULL && classes[0] == '1') ? true : false;
+    lock_timing = (timing != NULL && timing[0] == '1') ? true : false;
+    quarantine_limit = (quarantine != NULL) ? strtoull(quarantine, NULL, 0) : 0;
+    defer_coalescing = (defer != NULL && defer[0] == '1') ? true : false;
+    maintenance_ms = (defer_coalescing && interval != NULL) ? strtol(interval, NULL, 0) : 0;
+    
+    if (percpu != NULL && percpu[0] == '1') {
+        percpu_caches = dmm_percpu_init();
+    }
+    
+    if (pages != NULL && strcmp(pages, "thp") == 0) {
+        page_mode = PAGES_THP;
+    } else if (pages != NULL && strcmp(pages, "hugetlb") == 0) {
+        page_mode = PAGES_HUGETLB;
+    }
+    
+    init_heap(&default_heap, MAX_HEAP_SIZE);
+    
+    dmm_prof_init(); //DMALLOC_PROF_RATE, once; dmalloc_prof_set_rate changes it later
+    
+    pthread_atfork(dmalloc_prefork, dmalloc_postfork_parent, dmalloc_postfork_child);
+    
+    if (maintenance_ms > 0) {
         
-        freelist->prev = to_free_ptr;
+        //without the thread, the slow path still coalesces
         
-        freelist = to_free_ptr;
+        maintenance_running = true; //before the thread can look at it
         
+        if (pthread_create(&maintenance_thread, NULL, maintenance, NULL) != 0) {
+            maintenance_running = false;
+        }
     }
+}
+
+static arena_t* home_arena(dheap_t* h) {
     
+    unsigned int cpu, node = 0;
     
-    TO_UNUSED(to_free_ptr);
+    pthread_once(&setup_once, setup);
     
-    footer_t* footer_to_change = (footer_t*) (((void*) to_free_ptr) + METADATA_T_ALIGNED + (to_free_ptr->size));
+    if (nnodes > 1 && getcpu(&cpu, &node) != 0) {
+        node = 0;
+    }
     
-    TO_UNUSED(footer_to_change);
+    return &h->arenas[node < (unsigned int) nnodes ? node : 0];
+}
+
+static arena_t* arena_of(dheap_t* h, void* ptr) {
     
+    int i;
     
-    coalesce(freelist);
+    for (i = 0; i < nnodes; i++) {
+        arena_t* a = &h->arenas[i];
+        
+        //every used block lies below committed; the reservation above it is PROT_NONE
+        
+        if (a->head != NULL && ptr > (void*) a->head && ptr < __atomic_load_n(&a->committed, __ATOMIC_RELAXED)) {
+            return a;
+        }
+    }
+    return NULL;
 }
 
 /*
-    The coalesce function is also under constant time since it only check the
-    block behind and in front of it. 
-*/
-
-void coalesce(metadata_t* ptr) {
+ bin 0 takes blocks below 32 bytes, bin i >= 1 takes [2^(i+4), 2^(i+5)), and the
+ last bin everything above.
+ */
+static int bin_index(size_t size) {
+    if (size < 32) {
+        return 0;
+    }
     
-    //check the block behind it, this take constant time.
+    int i = (int) (8 * sizeof(size_t)) - 1 - __builtin_clzl(size) - 4;
     
-    metadata_t* next_block =  (metadata_t*) (((void*) ptr) + METADATA_T_ALIGNED + (ptr->size) + FOOTER_T_ALIGNED);
+    return i < NBINS ? i : NBINS - 1;
+}
+
+static bool index_init(arena_t* a) {
     
-    if (next_block->size%8 == 0) {
-        
-        if (next_block->prev != NULL) {
-            
-            next_block->prev->next = next_block->next;
-        }
+    size_t bits = a->region_bytes / ALIGNMENT;
+    size_t words[INDEX_LEVELS];
+    size_t total = 0;
+    int l;
+    
+    for (l = 0; l < INDEX_LEVELS; l++) {
+        words[l] = (bits + 63) / 64;
+        total += words[l];
+        bits = words[l];
         
-        if (next_block->next != NULL) {
-            
-            next_block->next->prev = next_block->prev;
+        if (words[l] == 1) {
+            break;
         }
+    }
+    
+    if (l == INDEX_LEVELS) {
+        return false; // a region this large needs more levels
+    }
+    
+    unsigned long* mem = mmap(NULL, total * sizeof(unsigned long), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    
+    a->index_levels = l + 1;
+    a->index_bytes = total * sizeof(unsigned long);
+    
+    for (l = 0; l < a->index_levels; l++) {
+        a->index[l] = mem;
+        mem += words[l];
+    }
+    
+    return true;
+}
+
+static void index_set(arena_t* a, metadata_t* block) {
+    
+    size_t i = (((void*) block) - ((void*) a->head)) / ALIGNMENT;
+    int l;
+    
+    for (l = 0; l < a->index_levels; l++) {
         
-        //increase the size of to_free_ptr
-        ptr->size += FOOTER_T_ALIGNED + METADATA_T_ALIGNED + (next_block->size);
+        unsigned long* word = &a->index[l][i >> 6];
+        unsigned long was = *word;
         
-        footer_t* footer_to_change = (footer_t*) (((void*) ptr) + METADATA_T_ALIGNED + (ptr->size));
+        *word = was | (1UL << (i & 63));
         
-        footer_to_change->size = ptr->size;
+        if (was != 0) {
+            break; // the levels above already know about this word
+        }
         
+        i >>= 6;
     }
+}
+
+static void index_clear(arena_t* a, metadata_t* block) {
     
-    //check the block in front of it, this take constant time.
+    size_t i = (((void*) block) - ((void*) a->head)) / ALIGNMENT;
+    int l;
     
-    if (ptr != head) {
+    for (l = 0; l < a->index_levels; l++) {
         
+        unsigned long* word = &a->index[l][i >> 6];
         
-        footer_t* prev_footer = (footer_t*) (((void*)ptr) - FOOTER_T_ALIGNED);
+        *word &= ~(1UL << (i & 63));
         
-        if (prev_footer->size%8 == 0) { //prev block is free
-            
-            metadata_t* prev_block = (metadata_t*) (((void*)prev_footer) - prev_footer->size - METADATA_T_ALIGNED); // new line
-            
-            if (prev_block->prev != NULL) {
-                
-                prev_block->prev->next = prev_block->next;                
-                
-            }
-            
-            if (prev_block->next != NULL) {
-                                
-                prev_block->next->prev = prev_block->prev;
-            }
-            
-            
-            prev_block->size += FOOTER_T_ALIGNED + METADATA_T_ALIGNED + (ptr->size) ; //increase the size
-            
-            prev_block->prev = NULL;
-            
-            if (freelist->next != prev_block) {
-
-                prev_block->next = freelist->next;
-                
-                if (freelist->next != NULL) {
-
-                    freelist->next->prev = prev_block;
-                }
-            }
-                     
-            freelist = prev_block;
-            
-            footer_t* footer_to_change = (footer_t*) (((void*) freelist) + METADATA_T_ALIGNED + (freelist->size));
-            
-            footer_to_change->size = freelist->size;
-            
+        if (*word != 0) {
+            break;
         }
+        
+        i >>= 6;
     }
+}
+
+/* the free block with the highest address below block, or NULL */
+static metadata_t* index_below(arena_t* a, metadata_t* block) {
     
-    footer_t* footer_to_change = (footer_t*) (((void*) freelist) + METADATA_T_ALIGNED + (freelist->size));
+    size_t i = (((void*) block) - ((void*) a->head)) / ALIGNMENT;
+    int l;
     
-    footer_to_change->size = freelist->size;
+    //up until some word has a bit below our position
     
-    TO_UNUSED(freelist);
-    TO_UNUSED(footer_to_change);
+    for (l = 0; l < a->index_levels; l++) {
+        
+        unsigned long below = a->index[l][i >> 6] & ((1UL << (i & 63)) - 1);
+        
+        if (below != 0) {
+            i = (i & ~63UL) | (63 - __builtin_clzl(below));
+            break;
+        }
+        
+        i >>= 6;
+    }
+    
+    if (l == a->index_levels) {
+        return NULL;
+    }
+    
+    //then down, always taking the highest bit
     
+    while (l > 0) {
+        l--;
+        i = (i << 6) | (63 - __builtin_clzl(a->index[l][i]));
+    }
     
+    return (metadata_t*) (((void*) a->head) + i * ALIGNMENT);
 }
 
-
-bool dmalloc_init() {
+/*
+ The free lists are only ever changed through these helpers. A block's size
+ must not change while it is on a list, since the bin it sits in is derived
+ from it.
+ */
+static void freelist_insert(arena_t* a, metadata_t* block) {
     
-    /* Two choices:
-     * 1. Append prologue and epilogue blocks to the start and the end of the freelist
-     * 2. Initialize freelist pointers to NULL
-     *
-     * Note: We provide the code for 2. Using 1 will help you to tackle the
-     * corner cases succinctly.
-     */
+    metadata_t** list = &a->freelist;
     
-    size_t max_bytes = ALIGN(MAX_HEAP_SIZE);
+    if (a->segregated) {
+        int i = bin_index(block->size);
+        list = &a->bins[i];
+        a->bin_map |= 1u << i;
+    }
     
+    //sorted, the block goes behind the nearest free block below it
     
-    freelist = (metadata_t*) sbrk(max_bytes); 
+    metadata_t* below = a->ordered ? index_below(a, block) : NULL;
     
-    if (freelist == (void *)-1)
-        return false;
+    if (a->ordered) {
+        index_set(a, block);
+    }
+    
+    if (below != NULL) {
+        block->prev = below;
+        block->next = below->next;
+        
+        if (below->next != NULL) {
+            below->next->prev = block;
+        }
+        
+        below->next = block;
+        a->free_blocks++;
+        return;
+    }
     
-    head = freelist;
-    tail = (((void *)freelist) + MAX_HEAP_SIZE);
+    block->prev = NULL;
+    block->next = *list;
     
-    freelist->next = NULL;
-    freelist->prev = NULL;
-    freelist->size = max_bytes - METADATA_T_ALIGNED - FOOTER_T_ALIGNED;
+    if (*list != NULL) {
+        (*list)->prev = block;
+    }
+    
+    *list = block;
+    a->free_blocks++;
+}
+
+static void freelist_remove(arena_t* a, metadata_t* block) {
     
-    footer_t* footer_init = (footer_t*) (((void*) freelist) + METADATA_T_ALIGNED + freelist->size);
+    metadata_t** list = &a->freelist;
+    int i = 0;
     
-    footer_init->size = freelist->size;
+    if (a->segregated) {
+        i = bin_index(block->size);
+        list = &a->bins[i];
+    }
     
+    if (a->ordered) {
+        index_clear(a, block);
+    }
     
-    return true;
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        *list = block->next;
+    }
+    
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    
+    if (a->segregated && *list == NULL) {
+        a->bin_map &= ~(1u << i);
+    }
+    
+    block->next = NULL;
+    block->prev = NULL;
+    a->free_blocks--;
 }
 
-/*Only for debugging purposes; can be turned off through -NDEBUG flag*/
-void print_freelist() {
-    metadata_t *freelist_head = freelist;
-    while(freelist_head != NULL) {
-        DEBUG("\tFreelist Size:%zd, Head:%p, Prev:%p, Next:%p\t",freelist_head->size,freelist_head,freelist_head->prev,freelist_head->next);
-        freelist_head = freelist_head->next;
+/*
+ Puts the remainder of a split where the split block was. On the single list
+ it keeps the block's position, which is what first-fit relies on, and also
+ keeps the list sorted, since the remainder lies inside the split block; with
+ bins the remainder usually belongs to a smaller bin.
+ */
+static void freelist_replace(arena_t* a, metadata_t* old_block, metadata_t* new_block) {
+    
+    if (a->segregated) {
+        freelist_remove(a, old_block);
+        freelist_insert(a, new_block);
+        return;
+    }
+    
+    if (a->ordered) {
+        index_clear(a, old_block);
+        index_set(a, new_block);
+    }
+    
+    new_block->prev = old_block->prev;
+    new_block->next = old_block->next;
+    
+    if (old_block->prev != NULL) {
+        old_block->prev->next = new_block;
+    } else {
+        a->freelist = new_block;
     }
-    DEBUG("\n");
     
-}
\ No newline at end of file
+    if (old_block->next != NULL) {
+        old_block->next->prev = new_block;
+    }
+    
+    old_block->next = NULL;
+    old_block->prev = NULL;
+}
+
+/*
+ First-fit over whichever structure is active. On the single list this is the
+ original walk. With bins only the home bin of the request needs a walk: every
+ block in a higher bin is big enough, so the first non-empty one found in
+ bin_map answers the request right away.
+ */
+static metadata_t* find_fit(arena_t* a, size_t requiredSpace, size_t* search_len) {
+    
+    metadata_t* cur_freelist = a->freelist;
+    
+    if (a->segregated) {
+        int i = bin_index(requiredSpace);
+        cur_freelist = a->bins[i];
+        
+        while (cur_freelist != NULL && cur_freelist->size < requiredSpace) {
+            cur_freelist = cur_freelist->next;
+            (*search_len)++;
+            
+            if (cur_freelist != NULL) {
+                PREFETCH(cur_freelist->next);
+            }
+        }
+        
+        if (cur_freelist == NULL) {
+            unsigned int higher = (i + 1 < NBINS) ? (a->bin_map & ~((2u << i) - 1)) : 0;
+            
+            if (higher != 0) {
+                cur_freelist = a->bins[__builtin_ctz(higher)];
+            }
+        }
+        
+        (*search_len)++;
+        return cur_freelist;
+    }
+    
+    while (cur_freelist != NULL && cur_freelist->size < requiredSpace) { //move the cur_freelist ptr to the start of the block with enough size
+        cur_freelist = cur_freelist->next;
+        (*search_len)++;
+        
+        if (cur_freelist != NULL) {
+            PREFETCH(cur_freelist->next);
+        }
+    }
+    
+    (*search_len)++;
+    return cur_freelist;
+}
+
+/*
+ Moves every free block over to the other lookup structure. This is O(#free
+ blocks), but the gap between SEARCH_HIGH and SHORT_LIST keeps it rare.
+ */
+static void switch_lookup(arena_t* a, bool to_segregated, bool to_ordered) {
+    
+    metadata_t* pending = NULL;
+    metadata_t* block;
+    int i;
+    
+    //chain all free blocks through next, then rebuild
+    
+    for (i = -1; i < NBINS; i++) {
+        block = (i < 0) ? a->freelist : a->bins[i];
+        while (block != NULL) {
+            metadata_t* next = block->next;
+            block->next = pending;
+            pending = block;
+            block = next;
+        }
+        if (i >= 0) {
+            a->bins[i] = NULL;
+        }
+    }
+    
+    a->freelist = NULL;
+    a->bin_map = 0;
+    a->free_blocks = 0;
+    a->search_avg = 0;
+    a->segregated = to_segregated;
+    
+    //the index is rebuilt by the inserts below; without one we stay unsorted.
+    //dropping its pages zeroes it without committing the whole reservation,
+    //as a memset would, and hands back the pages the old lookup touched
+    
+    if (a->index_levels > 0 && madvise(a->index[0], a->index_bytes, MADV_DONTNEED) != 0) {
+        memset(a->index[0], 0, a->index_bytes);
+    }
+    
+    a->ordered = (to_ordered && (a->index_levels > 0 || (a->head != NULL && index_init(a)))) ? true : false;
+    
+    while (pending != NULL) {
+        block = pending;
+        pending = pending->next;
+        freelist_insert(a, block);
+    }
+}
+
+static void adapt_policy(arena_t* a, size_t search_len) {
+    
+    a->search_avg += search_len - (a->search_avg >> SEARCH_AVG_SHIFT);
+    
+    if (a->heap->policy != DMM_POLICY_ADAPTIVE) {
+        return;
+    }
+    
+    if (!a->segregated && (a->search_avg >> SEARCH_AVG_SHIFT) > SEARCH_HIGH) {
+        switch_lookup(a, true, false);
+    } else if (a->segregated && a->free_blocks <= SHORT_LIST) {
+        switch_lookup(a, false, false);
+    }
+}
+
+void dmalloc_set_policy(dmm_policy_t new_policy) {
+    
+    int i;
+    
+    pthread_once(&setup_once, setup);
+    
+    default_heap.policy = new_policy;
+    
+    for (i = 0; i < nnodes; i++) {
+        arena_t* a = &default_heap.arenas[i];
+        
+        lock_acquire(&a->lock);
+        
+        if (new_policy == DMM_POLICY_FIRST_FIT && (a->segregated || a->ordered)) {
+            switch_lookup(a, false, false);
+        } else if (new_policy == DMM_POLICY_SEGREGATED && !a->segregated) {
+            switch_lookup(a, true, false);
+        } else if (new_policy == DMM_POLICY_ADDRESS_ORDERED && !a->ordered) {
+            switch_lookup(a, false, true);
+        } else if (new_policy == DMM_POLICY_ADAPTIVE && a->ordered) {
+            switch_lookup(a, false, false);
+        }
+        
+        lock_release(&a->lock);
+    }
+}
+
+size_t dmalloc_search_average() {
+    return home_arena(&default_heap)->search_avg >> SEARCH_AVG_SHIFT;
+}
+
+static metadata_t* free_block(arena_t* a, metadata_t* to_free_ptr);
+static size_t purge_block(arena_t* a, metadata_t* block);
+
+static void drain_remote_frees(arena_t* a) {
+    
+    metadata_t* pending = __atomic_exchange_n(&a->remote_frees, NULL, __ATOMIC_ACQUIRE);
+    
+    while (pending != NULL) {
+        metadata_t* block = pending;
+        pending = pending->next;
+        free_block(a, block);
+    }
+}
+
+/* merge sort of a list linked through next */
+static metadata_t* sort_by_address(metadata_t* list) {
+    
+    if (list == NULL || list->next == NULL) {
+        return list;
+    }
+    
+    metadata_t* slow = list;
+    metadata_t* fast = list->next;
+    
+    while (fast != NULL && fast->next != NULL) {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    
+    metadata_t* low = list;
+    metadata_t* high = slow->next;
+    metadata_t* sorted = NULL;
+    metadata_t** tail = &sorted;
+    
+    slow->next = NULL;
+    low = sort_by_address(low);
+    high = sort_by_address(high);
+    
+    while (low != NULL && high != NULL) {
+        if (low < high) {
+            *tail = low;
+            low = low->next;
+        } else {
+            *tail = high;
+            high = high->next;
+        }
+        tail = &(*tail)->next;
+    }
+    
+    *tail = (low != NULL) ? low : high;
+    
+    return sorted;
+}
+
+/* with the arena lock held; returns the number of blocks coalesced */
+static size_t drain_deferred(arena_t* a, bool purge) {
+    
+    metadata_t* pending = sort_by_address(__atomic_exchange_n(&a->deferred, NULL, __ATOMIC_ACQUIRE));
+    size_t count = 0;
+    
+    while (pending != NULL) {
+        
+        metadata_t* block = pending;
+        pending = pending->next;
+        
+        block = free_block(a, block);
+        count++;
+        
+        //the next pending block may still merge into this one, so purge once it cannot
+        
+        if (purge && (pending == NULL || (void*) pending > ((void*) block) + METADATA_T_ALIGNED + block->size + FOOTER_T_ALIGNED)) {
+            purge_block(a, block);
+        }
+    }
+    
+    return count;
+}
+
+static bool arena_init(arena_t* a);
+static bool commit_to(arena_t* a, void* end);
+
+/* called with a->lock held */
+static void* arena_alloc(arena_t* a, size_t numbytes) {
+    
+    //Initialize the arena's region the first time
+    
+    if(a->head == NULL) {
+        if(!arena_init(a)) {
+            return NULL;  //if freelist is successfully initiated, won't return NULL
+        }
+    }
+    
+    //after the first time, the heap will not be null, code goes here:
+    
+    if (a->remote_frees != NULL) {
+        drain_remote_frees(a);
+    }
+    
+    assert(numbytes > 0);
+    
+    if (numbytes > a->heap->size) {
+        return NULL; //can never fit, and ALIGN would overflow near SIZE_MAX
+    }
+    
+    size_t numbytes_aligned = PAYLOAD_ALIGN(numbytes); //align the requested numbytes
+    
+    size_t requiredSpace = (numbytes_aligned + FOOTER_T_ALIGNED + METADATA_T_ALIGNED);
+    
+    size_t search_len = 0; //number of free blocks inspected
+    
+    metadata_t* cur_freelist = find_fit(a, requiredSpace, &search_len);
+    
+    if (cur_freelist == NULL && a->deferred != NULL && drain_deferred(a, false) > 0) {
+        cur_freelist = find_fit(a, requiredSpace, &search_len);
+    }
+    
+    if (cur_freelist == NULL) {
+        DMM_TRACE2(malloc_fail, numbytes, search_len);
+        adapt_policy(a, search_len);
+        return NULL; //not enough space in freelist
+    }
+    
+    PREFETCH(((void*)cur_freelist) + METADATA_T_ALIGNED + cur_freelist->size); //where the remainder's footer goes
+    
+    //the new block and the remainder's header may reach into uncommitted space
+    
+    if (!commit_to(a, ((void*)cur_freelist) + requiredSpace + METADATA_T_ALIGNED)) {
+        DMM_TRACE2(malloc_fail, numbytes, search_len);
+        return NULL;
+    }
+   
+    // SPLIT step 1: Create footer for the block we're allocating
+
+    footer_t* new_footer = (footer_t*) (((void*)cur_freelist) + METADATA_T_ALIGNED + numbytes_aligned);
+    
+    new_footer->size = numbytes_aligned;
+    
+    TO_USED(new_footer);
+    
+    // SPLIT step 2: Create metadata for the remaining free block
+
+    metadata_t* new_freelist = (metadata_t*) (((void*)new_footer) + FOOTER_T_ALIGNED);
+    
+    //SPLIT step 3: fill in the metadata and the footer for the remaining free block
+    new_freelist->size = (cur_freelist->size) - numbytes_aligned - FOOTER_T_ALIGNED - METADATA_T_ALIGNED;
+
+    footer_t* footer_to_change = (footer_t*) (((void*) new_freelist) + METADATA_T_ALIGNED + (new_freelist->size));
+    
+    footer_to_change->size = new_freelist->size;
+    
+    DMM_TRACE3(split, cur_freelist, cur_freelist->size, new_freelist->size);
+    
+    // SPLIT step 4: the remainder takes the allocated block's place in the free list
+    
+    freelist_replace(a, cur_freelist, new_freelist);
+    
+    cur_freelist->size = numbytes_aligned; //update the cur_freelist size
+    TO_USED(cur_freelist); //update the cur_freelist boolean
+    SEAL(cur_freelist);
+    
+    DMM_TRACE3(fit, (void*)cur_freelist + METADATA_T_ALIGNED, numbytes, search_len);
+    
+    adapt_policy(a, search_len);
+    
+    return (void*) ((void*)cur_freelist + METADATA_T_ALIGNED);
+    
+}
+
+/*
+    Every allocation from this heap leaves through here, whichever cache or
+    list served it: fires dmm:malloc and charges the allocation to the
+    profiler. The only profiler cost for an unsampled allocation is the
+    decrement. A sampled block is marked in its header, which only the thread
+    holding the block writes.
+*/
+DMM_PROF_FRAME
+static void* account_alloc(void* ptr, size_t numbytes) {
+    
+    metadata_t* block = (metadata_t*) (ptr - METADATA_T_ALIGNED);
+    
+    if (ptr != NULL) {
+        DMM_TRACE2(malloc, ptr, numbytes);
+    }
+    
+    if (ptr != NULL && (dmm_prof_countdown -= (block->size & (~0x7))) < 0) {
+        if (dmm_prof_sample(ptr, numbytes)) {
+            TO_SAMPLED(block);
+        }
+    }
+    
+    return ptr;
+}
+
+static void* cached_alloc(arena_t* local, int cls);
+static size_t flush_cpu_cache();
+static void* class_alloc(arena_t* local, int cls);
+static size_t flush_class_lists(dheap_t* h);
+static size_t quarantine_flush(dheap_t* h);
+
+DMM_PROF_FRAME
+void* dheap_alloc(dheap_t* h, size_t numbytes) {
+    
+    arena_t* local = home_arena(h);
+    void* ptr = NULL;
+    int i;
+    
+    if (h == &default_heap && percpu_caches && numbytes > 0 && numbytes <= SMALL_MAX_SIZE) {
+        return account_alloc(cached_alloc(local, DMALLOC_SMALL_CLASS(numbytes)), numbytes);
+    }
+    
+    if (class_locks && numbytes > 0 && numbytes <= SMALL_MAX_SIZE) {
+        ptr = class_alloc(local, DMALLOC_SMALL_CLASS(numbytes));
+        
+        if (ptr != NULL) {
+            return account_alloc(ptr, numbytes);
+        }
+    }
+    
+    lock_acquire(&local->lock);
+    
+    ptr = arena_alloc(local, numbytes);
+    
+    lock_release(&local->lock);
+    
+    //when the local node is out of memory, borrow from the other nodes' arenas
+    
+    for (i = 0; ptr == NULL && i < nnodes; i++) {
+        arena_t* a = &h->arenas[i];
+        
+        if (a != local && a->head != NULL) {
+            lock_acquire(&a->lock);
+            ptr = arena_alloc(a, numbytes);
+            lock_release(&a->lock);
+        }
+    }
+    
+    //the blocks parked in the quarantine, this CPU's cache or the class lists may be what it takes
+    
+    if (ptr == NULL && quarantine_limit > 0 && quarantine_flush(h) > 0) {
+        return dheap_alloc(h, numbytes);
+    }
+    
+    if (ptr == NULL && h == &default_heap && percpu_caches && flush_cpu_cache() > 0) {
+        return dheap_alloc(h, numbytes);
+    }
+    
+    if (ptr == NULL && class_locks && flush_class_lists(h) > 0) {
+        return dheap_alloc(h, numbytes);
+    }
+    
+    return account_alloc(ptr, numbytes);
+}
+
+DMM_PROF_FRAME
+static void* heap_alloc(size_t numbytes) {
+    return dheap_alloc(&default_heap, numbytes);
+}
+
+DMM_PROF_FRAME
+void* dmalloc(size_t numbytes) {
+    
+    pthread_once(&setup_once, setup);
+    
+    return backend->alloc(numbytes);
+}
+
+/*
+    Out-of-line half of DMALLOC_FIXED: the class is already known, so a hit
+    in the CPU cache or the class list costs no size arithmetic at all. The
+    profiler sees the class size as the requested size.
+*/
+
+DMM_PROF_FRAME
+void* dmalloc_small(int cls) {
+    
+    arena_t* local = home_arena(&default_heap);
+    
+    if (percpu_caches) {
+        return account_alloc(cached_alloc(local, cls), SMALL_CLASS_SIZE(cls));
+    }
+    
+    if (class_locks) {
+        void* ptr = class_alloc(local, cls);
+        
+        if (ptr != NULL) {
+            return account_alloc(ptr, SMALL_CLASS_SIZE(cls));
+        }
+    }
+    
+    return dheap_alloc(&default_heap, SMALL_CLASS_SIZE(cls));
+}
+
+/*
+    In order to keep the dfree() under constant time, we move the to-free block to
+    the beginning of the free list. This operation doesn't involve looping 
+    through the freelist so it's O(1).
+*/
+
+static void free_central(dheap_t* h, metadata_t* to_free_ptr) {
+    
+    void* ptr = ((void*)to_free_ptr) + METADATA_T_ALIGNED;
+    
+    arena_t* a = (nnodes == 1) ? &h->arenas[0] : arena_of(h, ptr);
+    
+    assert(a != NULL && "dfree of a pointer that did not come from this heap");
+    
+    if (defer_coalescing) {
+        
+        //the block stays parked until drain_deferred coalesces it
+        
+        metadata_t* top = __atomic_load_n(&a->deferred, __ATOMIC_RELAXED);
+        do {
+            to_free_ptr->next = top;
+        } while (!__atomic_compare_exchange_n(&a->deferred, &top, to_free_ptr, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        
+        //read first, so frees do not all write the same line
+        
+        if (!__atomic_load_n(&deferred_pending, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&deferred_pending, true, __ATOMIC_RELEASE);
+        }
+        
+        return;
+    }
+    
+    if (!pthread_equal(pthread_self(), a->owner)) {
+        
+        //cross-thread free: hand the block to its home arena without touching the lock
+        
+        metadata_t* top = __atomic_load_n(&a->remote_frees, __ATOMIC_RELAXED);
+        do {
+            to_free_ptr->next = top;
+        } while (!__atomic_compare_exchange_n(&a->remote_frees, &top, to_free_ptr, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        
+        return;
+    }
+    
+    lock_acquire(&a->lock);
+    
+    free_block(a, to_free_ptr);
+    
+    lock_release(&a->lock);
+}
+
+static void flush_class(int cls, int nblocks);
+static void class_free(arena_t* a, int cls, metadata_t* block);
+static void release(dheap_t* h, metadata_t* to_free_ptr);
+static void quarantine_push(dheap_t* h, metadata_t* block);
+
+/* the small class an unsampled used block of exactly a class size belongs to, or -1 */
+static int small_class(metadata_t* block) {
+    
+    size_t size = block->size;
+    
+    if ((size & 0x7) != 0x1 || size > SMALL_MAX_SIZE + 1 || ((size & (~0x7)) % 16) != 0) {
+        return -1;
+    }
+    
+    return (int) ((size & (~0x7)) / 16) - 1;
+}
+
+void dheap_free(dheap_t* h, void* ptr) {
+    
+    if (ptr == NULL) {
+        return;
+    }
+    
+    metadata_t* to_free_ptr = (metadata_t*) (((void*)ptr) - METADATA_T_ALIGNED);
+    
+    if (((size_t) ptr & (DMALLOC_ALIGNMENT - 1)) != 0 || arena_of(h, ptr) == NULL) {
+        dmm_heap_abort("dfree of a pointer the heap does not own", ptr);
+    }
+    
+    //a free block, or one already parked, is a double free; O(1) either way
+    
+    if ((to_free_ptr->size & 0x5) != 0x1) {
+        dmm_heap_abort("double free", ptr);
+    }
+    
+    DMM_TRACE2(free, ptr, to_free_ptr->size & (~0x7));
+    
+    if (integrity_checks) {
+        verify_used(to_free_ptr);
+    }
+    
+    if (quarantine_limit > 0 && (to_free_ptr->size & (~0x7)) <= quarantine_limit / 2) {
+        quarantine_push(h, to_free_ptr);
+        return;
+    }
+    
+    release(h, to_free_ptr);
+}
+
+/* hands a block the program freed to a cache, a class list or its arena */
+static void release(dheap_t* h, metadata_t* to_free_ptr) {
+    
+    void* ptr = ((void*)to_free_ptr) + METADATA_T_ALIGNED;
+    
+    int cls = small_class(to_free_ptr);
+    
+    TO_PARKED(to_free_ptr); //free_block clears it with the used bit
+    
+    if (h == &default_heap && percpu_caches && cls >= 0) {
+        
+        if (dmm_percpu_push(cls, ptr)) {
+            return;
+        }
+        
+        flush_class(cls, PERCPU_SLOTS / 2);
+        
+        if (dmm_percpu_push(cls, ptr)) {
+            return;
+        }
+    }
+    
+    if (class_locks && cls >= 0) {
+        
+        arena_t* a = (nnodes == 1) ? &h->arenas[0] : arena_of(h, ptr);
+        
+        assert(a != NULL && "dfree of a pointer that did not come from this heap");
+        
+        class_free(a, cls, to_free_ptr);
+        return;
+    }
+    
+    free_central(h, to_free_ptr);
+}
+
+static void verify_poison(metadata_t* block) {
+    
+    size_t* word = (size_t*) (((void*) block) + METADATA_T_ALIGNED);
+    size_t i, n = (block->size & (~0x7)) / sizeof(size_t);
+    
+    for (i = 0; i < n; i++) {
+        if (word[i] != QUARANTINE_POISON) {
+            dmm_heap_abort("use after free: a block in quarantine was written to", ((void*) block) + METADATA_T_ALIGNED);
+        }
+    }
+}
+
+/* checks and releases a chain of blocks detached from the quarantine */
+static size_t quarantine_release(dheap_t* h, metadata_t* chain) {
+    
+    size_t n = 0;
+    
+    while (chain != NULL) {
+        
+        metadata_t* next = chain->next;
+        
+        verify_poison(chain);
+        
+        if (integrity_checks) {
+            verify_used(chain);
+        }
+        
+        TO_UNPARKED(chain);
+        release(h, chain);
+        
+        chain = next;
+        n++;
+    }
+    
+    return n;
+}
+
+static void quarantine_push(dheap_t* h, metadata_t* block) {
+    
+    quarantine_t* q = &h->quarantine;
+    size_t size = block->size & (~0x7);
+    metadata_t* leaving = NULL;
+    
+    memset(((void*) block) + METADATA_T_ALIGNED, QUARANTINE_POISON & 0xff, size);
+    
+    TO_PARKED(block);
+    block->next = NULL;
+    
+    lock_acquire(&q->lock);
+    
+    if (q->newest != NULL) {
+        q->newest->next = block;
+    } else {
+        q->oldest = block;
+    }
+    
+    q->newest = block;
+    q->bytes += size;
+    
+    //the oldest blocks leave until the rest fits
+    
+    if (q->bytes > quarantine_limit) {
+        
+        metadata_t* last = NULL;
+        
+        leaving = q->oldest;
+        
+        while (q->bytes > quarantine_limit) {
+            last = q->oldest;
+            q->bytes -= last->size & (~0x7);
+            q->oldest = last->next;
+        }
+        
+        last->next = NULL;
+        
+        if (q->oldest == NULL) {
+            q->newest = NULL;
+        }
+    }
+    
+    lock_release(&q->lock);
+    
+    quarantine_release(h, leaving);
+}
+
+static size_t quarantine_flush(dheap_t* h) {
+    
+    quarantine_t* q = &h->quarantine;
+    
+    lock_acquire(&q->lock);
+    
+    metadata_t* leaving = q->oldest;
+    
+    q->oldest = NULL;
+    q->newest = NULL;
+    q->bytes = 0;
+    
+    lock_release(&q->lock);
+    
+    return quarantine_release(h, leaving);
+}
+
+size_t dmalloc_quarantine_flush() {
+    
+    pthread_once(&setup_once, setup);
+    
+    return quarantine_flush(&default_heap);
+}
+
+static void heap_free(void* ptr) {
+    dheap_free(&default_heap, ptr);
+}
+
+/* blocks from dmemalign and the size classes come from this heap whatever the backend */
+static const dmm_backend_t* backend_of(void* ptr) {
+    return (backend != &heap_backend && backend->owns(ptr)) ? backend : &heap_backend;
+}
+
+void dfree(void* ptr) {
+    backend_of(ptr)->free(ptr);
+}
+
+static void* cached_alloc(arena_t* local, int cls) {
+    
+    int i;
+    
+    void* ptr = dmm_percpu_pop(cls);
+    
+    if (ptr != NULL) {
+        metadata_t* block = (metadata_t*) (ptr - METADATA_T_ALIGNED);
+        TO_UNPARKED(block);
+        return ptr;
+    }
+    
+    //refill: one block for the caller and a batch for the cache
+    
+    lock_acquire(&local->lock);
+    
+    ptr = arena_alloc(local, SMALL_CLASS_SIZE(cls));
+    
+    for (i = 1; ptr != NULL && i < PERCPU_BATCH; i++) {
+        
+        void* extra = arena_alloc(local, SMALL_CLASS_SIZE(cls));
+        
+        if (extra == NULL) {
+            break;
+        }
+        
+        if (!dmm_percpu_push(cls, extra)) {
+            free_block(local, (metadata_t*) (extra - METADATA_T_ALIGNED));
+            break;
+        }
+    }
+    
+    lock_release(&local->lock);
+    
+    if (ptr == NULL && flush_cpu_cache() > 0) {
+        return cached_alloc(local, cls);
+    }
+    
+    return ptr;
+}
+
+static void flush_class(int cls, int nblocks) {
+    
+    void* ptr;
+    
+    while (nblocks-- > 0 && (ptr = dmm_percpu_pop(cls)) != NULL) {
+        free_central(&default_heap, (metadata_t*) (ptr - METADATA_T_ALIGNED));
+    }
+}
+
+/* hands every block cached on the calling CPU back; returns how many */
+static size_t flush_cpu_cache() {
+    
+    size_t flushed = 0;
+    void* ptr;
+    int cls;
+    
+    for (cls = 0; cls < SMALL_CLASSES; cls++) {
+        while ((ptr = dmm_percpu_pop(cls)) != NULL) {
+            free_central(&default_heap, (metadata_t*) (ptr - METADATA_T_ALIGNED));
+            flushed++;
+        }
+    }
+    
+    return flushed;
+}
+
+static void* class_alloc(arena_t* local, int cls) {
+    
+    class_list_t* cl = &local->classes[cls];
+    metadata_t* batch = NULL;
+    metadata_t* last = NULL;
+    int n = 0;
+    
+    lock_acquire(&cl->lock);
+    
+    metadata_t* block = cl->blocks;
+    
+    if (block != NULL) {
+        cl->blocks = block->next;
+        cl->count--;
+    }
+    
+    lock_release(&cl->lock);
+    
+    if (block != NULL) {
+        TO_UNPARKED(block);
+        return ((void*)block) + METADATA_T_ALIGNED;
+    }
+    
+    //miss: carve a block for the caller and a batch under the arena lock, then stock the list
+    
+    lock_acquire(&local->lock);
+    
+    void* ptr = arena_alloc(local, SMALL_CLASS_SIZE(cls));
+    
+    while (ptr != NULL && n < CLASS_BATCH - 1) {
+        
+        void* extra = arena_alloc(local, SMALL_CLASS_SIZE(cls));
+        
+        if (extra == NULL) {
+            break;
+        }
+        
+        block = (metadata_t*) (extra - METADATA_T_ALIGNED);
+        block->next = batch;
+        batch = block;
+        last = (last == NULL) ? block : last;
+        n++;
+    }
+    
+    lock_release(&local->lock);
+    
+    if (batch != NULL) {
+        lock_acquire(&cl->lock);
+        last->next = cl->blocks;
+        cl->blocks = batch;
+        cl->count += n;
+        lock_release(&cl->lock);
+    }
+    
+    return ptr;
+}
+
+static void free_batch(arena_t* a, metadata_t* batch) {
+    
+    lock_acquire(&a->lock);
+    
+    while (batch != NULL) {
+        metadata_t* next = batch->next;
+        free_block(a, batch);
+        batch = next;
+    }
+    
+    lock_release(&a->lock);
+}
+
+static void class_free(arena_t* a, int cls, metadata_t* block) {
+    
+    class_list_t* cl = &a->classes[cls];
+    metadata_t* spill = NULL;
+    
+    lock_acquire(&cl->lock);
+    
+    block->next = cl->blocks;
+    cl->blocks = block;
+    
+    if (++cl->count > CLASS_LIST_MAX) {
+        
+        //keep the most recently freed half, the rest goes back to the arena
+        
+        metadata_t* keep = cl->blocks;
+        int i;
+        
+        for (i = 1; i < CLASS_LIST_MAX / 2; i++) {
+            keep = keep->next;
+        }
+        
+        spill = keep->next;
+        keep->next = NULL;
+        cl->count = CLASS_LIST_MAX / 2;
+    }
+    
+    lock_release(&cl->lock);
+    
+    if (spill != NULL) {
+        free_batch(a, spill);
+    }
+}
+
+/* empties every class list of the heap into its arena; returns how many blocks moved */
+static size_t flush_class_lists(dheap_t* h) {
+    
+    size_t flushed = 0;
+    int i, cls;
+    
+    for (i = 0; i < nnodes; i++) {
+        
+        arena_t* a = &h->arenas[i];
+        
+        for (cls = 0; cls < SMALL_CLASSES; cls++) {
+            
+            class_list_t* cl = &a->classes[cls];
+            
+            lock_acquire(&cl->lock);
+            metadata_t* batch = cl->blocks;
+            flushed += cl->count;
+            cl->blocks = NULL;
+            cl->count = 0;
+            lock_release(&cl->lock);
+            
+            if (batch != NULL) {
+                free_batch(a, batch);
+            }
+        }
+    }
+    
+    return flushed;
+}
+
+/* called with a->lock held */
+static metadata_t* free_block(arena_t* a, metadata_t* to_free_ptr) {
+    
+    void* ptr = ((void*)to_free_ptr) + METADATA_T_ALIGNED;
+    
+    PREFETCH(ptr + (to_free_ptr->size & (~0x7))); //the footer, and the next block's header behind it
+    
+    if (IS_SAMPLED(to_free_ptr)) {
+        dmm_prof_forget(ptr);
+    }
+    
+    TO_UNUSED(to_free_ptr);
+    
+    footer_t* footer_to_change = (footer_t*) (((void*) to_free_ptr) + METADATA_T_ALIGNED + (to_free_ptr->size));
+    
+    TO_UNUSED(footer_to_change);
+    
+    //merge with the neighbours first, then put the result at the front
+    
+    metadata_t* merged = coalesce(a, to_free_ptr);
+    
+    freelist_insert(a, merged);
+    
+    return merged;
+}
+
+/*
+    Aligned allocation. We over-allocate by the alignment plus room for one
+    more block, then cut the front of the block off at the first aligned
+    payload address that leaves space for a header and footer there, and free
+    that front piece. The slack at the end stays with the allocation.
+*/
+
+DMM_PROF_FRAME
+void* dmemalign(size_t alignment, size_t numbytes) {
+    
+    if (alignment <= DMALLOC_ALIGNMENT) {
+        return dmalloc(numbytes);
+    }
+    
+    if ((alignment & (alignment - 1)) != 0 || numbytes > MAX_HEAP_SIZE || alignment > MAX_HEAP_SIZE) {
+        return NULL;
+    }
+    
+    arena_t* a = home_arena(&default_heap);
+    
+    lock_acquire(&a->lock);
+    
+    void* ptr = arena_alloc(a, numbytes + alignment + METADATA_T_ALIGNED + FOOTER_T_ALIGNED);
+    
+    if (ptr != NULL && ((size_t) ptr & (alignment - 1)) != 0) {
+        
+        metadata_t* front = (metadata_t*) (ptr - METADATA_T_ALIGNED);
+        
+        size_t block_size = front->size & (~0x7);
+        
+        void* aligned = (void*) ((((size_t) ptr) + METADATA_T_ALIGNED + FOOTER_T_ALIGNED + alignment - 1) & ~(alignment - 1));
+        
+        size_t gap = aligned - ptr; //bytes handed back, header and footer included
+        
+        metadata_t* block = (metadata_t*) (aligned - METADATA_T_ALIGNED);
+        
+        block->size = block_size - gap;
+        TO_USED(block);
+        SEAL(block);
+        
+        footer_t* block_footer = (footer_t*) (aligned + (block_size - gap));
+        block_footer->size = block->size;
+        
+        front->size = gap - METADATA_T_ALIGNED - FOOTER_T_ALIGNED;
+        TO_USED(front);
+        
+        footer_t* front_footer = (footer_t*) (((void*) block) - FOOTER_T_ALIGNED);
+        front_footer->size = front->size;
+        
+        free_block(a, front);
+        
+        ptr = aligned;
+    }
+    
+    lock_release(&a->lock);
+    
+    return account_alloc(ptr, numbytes);
+}
+
+static size_t heap_usable_size(void* ptr) {
+    
+    metadata_t* block = (metadata_t*) (ptr - METADATA_T_ALIGNED);
+    
+    return block->size & (~0x7);
+}
+
+/* whether ptr lies inside one of the arenas; stable once they exist */
+static bool heap_owns(void* ptr) {
+    return arena_of(&default_heap, ptr) != NULL ? true : false;
+}
+
+size_t dmalloc_usable_size(void* ptr) {
+    return backend_of(ptr)->usable_size(ptr);
+}
+
+bool dmalloc_owns(void* ptr) {
+    return (backend->owns(ptr) || heap_owns(ptr)) ? true : false;
+}
+
+const char* dmalloc_backend() {
+    
+    pthread_once(&setup_once, setup);
+    
+    return backend->name;
+}
+
+/*
+    fork() support: hold every arena lock of every heap across the fork,
+    always in list and index order and before the profiler's lock, so the
+    child never starts with a lock some other thread of the parent was
+    holding. In the child the forking thread is the only one left, so it
+    becomes the owner of every arena. Blocks other threads had pushed onto remote_frees stay there and
+    are drained by the child as usual. setup registers these with
+    pthread_atfork, so every process using the heap gets them.
+*/
+
+void dmalloc_prefork() {
+    int i, cls;
+    pthread_once(&setup_once, setup);
+    pthread_mutex_lock(&heaps_lock);
+    for (dheap_t* h = heaps; h != NULL; h = h->next) {
+        for (i = 0; i < nnodes; i++) {
+            pthread_mutex_lock(&h->arenas[i].lock.mutex);
+            for (cls = 0; cls < SMALL_CLASSES; cls++) {
+                pthread_mutex_lock(&h->arenas[i].classes[cls].lock.mutex);
+            }
+        }
+        pthread_mutex_lock(&h->quarantine.lock.mutex);
+    }
+    dmm_prof_prefork();
+}
+
+void dmalloc_postfork_parent() {
+    int i, cls;
+    dmm_prof_postfork_parent();
+    for (dheap_t* h = heaps; h != NULL; h = h->next) {
+        pthread_mutex_unlock(&h->quarantine.lock.mutex);
+        for (i = nnodes - 1; i >= 0; i--) {
+            for (cls = SMALL_CLASSES - 1; cls >= 0; cls--) {
+                pthread_mutex_unlock(&h->arenas[i].classes[cls].lock.mutex);
+            }
+            pthread_mutex_unlock(&h->arenas[i].lock.mutex);
+        }
+    }
+    pthread_mutex_unlock(&heaps_lock);
+}
+
+void dmalloc_postfork_child() {
+    int i, cls;
+    dmm_prof_postfork_child();
+    for (dheap_t* h = heaps; h != NULL; h = h->next) {
+        for (i = 0; i < nnodes; i++) {
+            pthread_mutex_init(&h->arenas[i].lock.mutex, NULL);
+            h->arenas[i].owner = pthread_self();
+            for (cls = 0; cls < SMALL_CLASSES; cls++) {
+                pthread_mutex_init(&h->arenas[i].classes[cls].lock.mutex, NULL);
+            }
+        }
+        pthread_mutex_init(&h->quarantine.lock.mutex, NULL);
+    }
+    pthread_mutex_init(&heaps_lock, NULL);
+    pthread_mutex_init(&maintenance_lock, NULL);
+    maintenance_running = false; // the thread was not forked with us
+}
+
+/*
+    Emergency pool. dmalloc and dfree take arena locks, so they must not be
+    called from a signal handler: the interrupted code may hold the lock, or
+    be halfway through relinking a free list. A thread that wants to allocate
+    from its crash or signal handlers reserves a private pool up front with
+    dmalloc_emergency_reserve; dmalloc_emergency then bumps a thread-local
+    offset with an atomic add and touches nothing else, which makes it
+    async-signal-safe, nested signals included. Emergency blocks are never
+    freed one by one and must not be passed to dfree; the pool lives as long
+    as the thread's process.
+*/
+
+static __thread char* emergency_pool __attribute__((tls_model("initial-exec")));
+static __thread size_t emergency_size __attribute__((tls_model("initial-exec")));
+static __thread size_t emergency_used __attribute__((tls_model("initial-exec")));
+
+bool dmalloc_emergency_reserve(size_t numbytes) {
+    
+    if (emergency_pool != NULL) {
+        return true;
+    }
+    
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t bytes = (numbytes + page - 1) & ~(page - 1);
+    
+    char* pool = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    
+    if (pool == MAP_FAILED) {
+        return false;
+    }
+    
+    emergency_size = bytes;
+    emergency_pool = pool;
+    
+    return true;
+}
+
+void* dmalloc_emergency(size_t numbytes) {
+    
+    if (emergency_pool == NULL || numbytes == 0 || numbytes > emergency_size) {
+        return NULL;
+    }
+    
+    size_t numbytes_aligned = PAYLOAD_ALIGN(numbytes);
+    size_t start = __atomic_fetch_add(&emergency_used, numbytes_aligned, __ATOMIC_RELAXED);
+    
+    if (start + numbytes_aligned > emergency_size) {
+        return NULL; //the pool is used up; emergency_used stays past the end
+    }
+    
+    return emergency_pool + start;
+}
+
+/*
+    The coalesce function is also under constant time since it only check the
+    block behind and in front of it. ptr must not be on a free list; the
+    merged block is returned, also off the lists.
+*/
+
+metadata_t* coalesce(arena_t* a, metadata_t* ptr) {
+    
+    //check the block behind it, this take constant time.
+    
+    metadata_t* next_block =  (metadata_t*) (((void*) ptr) + METADATA_T_ALIGNED + (ptr->size) + FOOTER_T_ALIGNED);
+    
+    //ask for the free list neighbours of the next block and for the previous block before merging either
+    
+    if (next_block < a->tail && next_block->size%8 == 0) {
+        PREFETCH(next_block->next);
+        PREFETCH(next_block->prev);
+    }
+    
+    if (ptr != a->head) {
+        footer_t* before = (footer_t*) (((void*)ptr) - FOOTER_T_ALIGNED);
+        
+        if (before->size%8 == 0) {
+            PREFETCH(((void*)before) - before->size - METADATA_T_ALIGNED);
+        }
+    }
+    
+    if (integrity_checks && next_block < a->tail) {
+        
+        footer_t* next_footer = (footer_t*) (((void*) next_block) + METADATA_T_ALIGNED + (next_block->size & (~0x7)));
+        
+        if ((void*) next_footer >= ((void*) a->tail) || next_footer->size != (next_block->size & (~0x6))) {
+            dmm_heap_abort("heap corruption: boundary tags of the next block disagree", next_block);
+        }
+        
+        if (next_block->size % 8 != 0 && (size_t) next_block->prev != checksum(next_block)) {
+            dmm_heap_abort("heap corruption: bad header checksum of the next block", next_block);
+        }
+    }
+    
+    if (next_block < a->tail && next_block->size%8 == 0) {
+        
+        freelist_remove(a, next_block);
+        
+        //increase the size of to_free_ptr
+        ptr->size += FOOTER_T_ALIGNED + METADATA_T_ALIGNED + (next_block->size);
+        
+        footer_t* footer_to_change = (footer_t*) (((void*) ptr) + METADATA_T_ALIGNED + (ptr->size));
+        
+        footer_to_change->size = ptr->size;
+        
+        DMM_TRACE3(coalesce, ptr, ptr->size, 0);
+    }
+    
+    //check the block in front of it, this take constant time.
+    
+    if (ptr != a->head) {
+        
+        footer_t* prev_footer = (footer_t*) (((void*)ptr) - FOOTER_T_ALIGNED);
+        
+        if (prev_footer->size%8 == 0) { //prev block is free
+            
+            metadata_t* prev_block = (metadata_t*) (((void*)prev_footer) - prev_footer->size - METADATA_T_ALIGNED); // new line
+            
+            if (integrity_checks && (prev_block < a->head || prev_block >= ptr || prev_block->size != prev_footer->size)) {
+                dmm_heap_abort("heap corruption: boundary tags of the previous block disagree", prev_footer);
+            }
+            
+            freelist_remove(a, prev_block);
+            
+            prev_block->size += FOOTER_T_ALIGNED + METADATA_T_ALIGNED + (ptr->size) ; //increase the size
+            
+            footer_t* footer_to_change = (footer_t*) (((void*) prev_block) + METADATA_T_ALIGNED + (prev_block->size));
+            
+            footer_to_change->size = prev_block->size;
+            
+            ptr = prev_block;
+            
+            DMM_TRACE3(coalesce, ptr, ptr->size, 1);
+        }
+    }
+    
+    return ptr;
+}
+
+/*
+ Reserves the arena's region. Huge page mappings are rounded up to whole huge
+ pages; only the first bytes of them are used.
+ */
+static void* map_region(arena_t* a, size_t bytes) {
+    
+    void* region = MAP_FAILED;
+    
+    size_t huge_bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    
+    a->page_size = (size_t) sysconf(_SC_PAGESIZE);
+    a->commit_chunk = COMMIT_CHUNK;
+    
+    if (page_mode == PAGES_HUGETLB) {
+        //no MAP_NORESERVE here: without a reservation an empty pool means SIGBUS on first touch, not a failed mmap
+        region = mmap(NULL, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    
+    if (region != MAP_FAILED) {
+        a->page_size = HUGE_PAGE_SIZE;
+        a->region_bytes = huge_bytes;
+        a->committed = region + huge_bytes; //hugetlbfs pages cannot be committed piecemeal
+    } else if (page_mode != PAGES_SMALL) {
+        
+        //over-map by one huge page and trim both ends to get 2 MiB alignment
+        
+        void* raw = mmap(NULL, huge_bytes + HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        
+        if (raw == MAP_FAILED)
+            return NULL;
+        
+        region = (void*) ((((size_t) raw) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+        
+        if (region != raw) {
+            munmap(raw, region - raw);
+            munmap(region + huge_bytes, (raw + HUGE_PAGE_SIZE) - region);
+        } else {
+            munmap(region + huge_bytes, HUGE_PAGE_SIZE);
+        }
+        
+        madvise(region, huge_bytes, MADV_HUGEPAGE); //a hint; fails harmlessly where THP is off
+        a->page_size = HUGE_PAGE_SIZE;
+        a->commit_chunk = HUGE_PAGE_SIZE;
+        a->region_bytes = huge_bytes;
+        a->committed = region;
+    } else {
+        
+        region = mmap(NULL, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        
+        if (region == MAP_FAILED)
+            return NULL;
+        
+        a->region_bytes = bytes;
+        a->committed = region;
+    }
+    
+    if (nnodes > 1) {
+        //best effort: prefer the arena's node for every page of the region
+        unsigned long nodemask = 1UL << a->node;
+        syscall(SYS_mbind, region, bytes, MPOL_PREFERRED, &nodemask, 8 * sizeof(nodemask), 0);
+    }
+    
+    return region;
+}
+
+/*
+ Makes the region accessible up to end, in whole commit chunks. Fails only
+ when the kernel refuses the commit charge.
+ */
+static bool commit_to(arena_t* a, void* end) {
+    
+    if (end <= a->committed) {
+        return true;
+    }
+    
+    void* region_end = ((void*) a->head) - REGION_PAD + a->region_bytes;
+    void* new_committed = (void*) ((((size_t) end) + a->commit_chunk - 1) & ~(a->commit_chunk - 1));
+    
+    if (new_committed > region_end) {
+        new_committed = region_end;
+    }
+    
+    if (mprotect(a->committed, new_committed - a->committed, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
+    
+    a->committed = new_committed;
+    return true;
+}
+
+/* called with a->lock held */
+static bool arena_init(arena_t* a) {
+    
+    /* Two choices:
+     * 1. Append prologue and epilogue blocks to the start and the end of the freelist
+     * 2. Initialize freelist pointers to NULL
+     *
+     * Note: We provide the code for 2. Using 1 will help you to tackle the
+     * corner cases succinctly.
+     */
+    
+    size_t max_bytes = ALIGN(a->heap->size);
+    
+    void* region = map_region(a, max_bytes);
+    
+    if (region == NULL)
+        return false;
+    
+    metadata_t* first_block = (metadata_t*) (region + REGION_PAD);
+    size_t first_size = (max_bytes - REGION_PAD - METADATA_T_ALIGNED - FOOTER_T_ALIGNED) & ~(DMALLOC_ALIGNMENT - 1);
+    
+    a->head = first_block;
+    a->tail = (((void *)first_block) + METADATA_T_ALIGNED + first_size + FOOTER_T_ALIGNED);
+    
+    //the first block's header and the end footer are written right away
+    
+    void* last_page = (void*) ((((size_t) a->tail) - FOOTER_T_ALIGNED) & ~(a->page_size - 1));
+    
+    if (!commit_to(a, ((void*) first_block) + METADATA_T_ALIGNED)
+        || (last_page >= a->committed && mprotect(last_page, region + a->region_bytes - last_page, PROT_READ | PROT_WRITE) != 0)) {
+        munmap(region, a->region_bytes);
+        a->head = NULL;
+        a->tail = NULL;
+        return false;
+    }
+    
+    a->owner = pthread_self();
+    
+    DMM_TRACE2(heap_grow, a->head, max_bytes);
+    
+    first_block->size = first_size;
+    
+    footer_t* footer_init = (footer_t*) (((void*) first_block) + METADATA_T_ALIGNED + first_block->size);
+    
+    footer_init->size = first_block->size;
+    
+    if (a->heap->policy == DMM_POLICY_ADDRESS_ORDERED) {
+        a->ordered = index_init(a); // without the index the list just stays unsorted
+    }
+    
+    freelist_insert(a, first_block);
+    
+    return true;
+}
+
+/* sets up the calling thread's arena ahead of the first dmalloc */
+static bool heap_init() {
+    
+    arena_t* a = home_arena(&default_heap);
+    bool ok = true;
+    
+    lock_acquire(&a->lock);
+    
+    if (a->head == NULL) {
+        ok = arena_init(a);
+    }
+    
+    lock_release(&a->lock);
+    
+    return ok;
+}
+
+bool dmalloc_init() {
+    
+    pthread_once(&setup_once, setup);
+    
+    return backend->init();
+}
+
+/*
+    Separate heaps. The dheap_t itself is mmap'ed too, since the heap manager
+    cannot allocate its own bookkeeping from a heap. Each arena's region is
+    mapped on first use, like the default heap's.
+*/
+
+dheap_t* dheap_create(size_t size) {
+    
+    pthread_once(&setup_once, setup);
+    
+    if (size < METADATA_T_ALIGNED + FOOTER_T_ALIGNED + ALIGNMENT || size > ((size_t) -1) / 2) {
+        return NULL;
+    }
+    
+    dheap_t* h = (dheap_t*) mmap(NULL, sizeof(dheap_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    
+    if (h == MAP_FAILED) {
+        return NULL;
+    }
+    
+    init_heap(h, ALIGN(size));
+    
+    pthread_mutex_lock(&heaps_lock);
+    h->next = default_heap.next;
+    default_heap.next = h;
+    pthread_mutex_unlock(&heaps_lock);
+    
+    return h;
+}
+
+/*
+    Releases a heap with everything still allocated in it. No other thread
+    may use the heap, or any block from it, once this starts.
+*/
+void dheap_destroy(dheap_t* h) {
+    
+    dheap_t* prev;
+    int i;
+    
+    assert(h != &default_heap && "the default heap cannot be destroyed");
+    
+    pthread_mutex_lock(&heaps_lock);
+    for (prev = &default_heap; prev->next != h; prev = prev->next)
+        ;
+    prev->next = h->next;
+    pthread_mutex_unlock(&heaps_lock);
+    
+    for (i = 0; i < nnodes; i++) {
+        
+        arena_t* a = &h->arenas[i];
+        metadata_t* block = a->head;
+        
+        //the profiler must not keep pointers into the unmapped region
+        
+        while (block != NULL && block < a->tail) {
+            
+            size_t size = block->size & (~0x7);
+            
+            if ((block->size & 0x1) && IS_SAMPLED(block)) {
+                dmm_prof_forget(((void*)block) + METADATA_T_ALIGNED);
+            }
+            
+            block = (metadata_t*) (((void*)block) + METADATA_T_ALIGNED + size + FOOTER_T_ALIGNED);
+        }
+        
+        if (a->head != NULL) {
+            munmap(((void*) a->head) - REGION_PAD, a->region_bytes);
+        }
+        
+        if (a->index_levels > 0) {
+            munmap(a->index[0], a->index_bytes);
+        }
+    }
+    
+    munmap(h, sizeof(dheap_t));
+}
+
+/*
+    Visits every physical block from head to tail by hopping over the sizes in
+    the headers, so it works in any build and allocates nothing. The callback
+    gets the payload address, the payload size and whether the block is in
+    use; it must not call dmalloc or dfree. Arenas are visited one after the
+    other.
+*/
+
+void dmalloc_walk(dmalloc_walker_t callback, void* arg) {
+    
+    int i;
+    
+    pthread_once(&setup_once, setup);
+    
+    for (i = 0; i < nnodes; i++) {
+        
+        arena_t* a = &default_heap.arenas[i];
+        
+        lock_acquire(&a->lock);
+        
+        if (a->remote_frees != NULL) {
+            drain_remote_frees(a);
+        }
+        
+        if (a->deferred != NULL) {
+            drain_deferred(a, false);
+        }
+        
+        metadata_t* block = a->head;
+        
+        while (block != NULL && block < a->tail) {
+            
+            size_t size = block->size & (~0x7);
+            
+            callback(((void*)block) + METADATA_T_ALIGNED, size, (block->size & 0x1) ? true : false, arg);
+            
+            block = (metadata_t*) (((void*)block) + METADATA_T_ALIGNED + size + FOOTER_T_ALIGNED);
+        }
+        
+        lock_release(&a->lock);
+    }
+}
+
+/*
+    Gives the memory of free blocks back to the kernel with MADV_DONTNEED.
+    Only whole pages between a free block's header and footer go, and with
+    huge pages only whole, aligned huge pages, so a huge page that still
+    holds live data is never split. Returns the number of bytes purged.
+*/
+
+static size_t purge_block(arena_t* a, metadata_t* block) {
+    
+    size_t start = ((size_t) block + METADATA_T_ALIGNED + a->page_size - 1) & ~(a->page_size - 1);
+    size_t end = ((size_t) block + METADATA_T_ALIGNED + block->size) & ~(a->page_size - 1);
+    
+    if (end > (size_t) a->committed) {
+        end = (size_t) a->committed; //nothing was ever touched beyond
+    }
+    
+    if (start < end && madvise((void*) start, end - start, MADV_DONTNEED) == 0) {
+        return end - start;
+    }
+    
+    return 0;
+}
+
+size_t dmalloc_purge() {
+    
+    size_t purged = 0;
+    int i, j;
+    
+    pthread_once(&setup_once, setup);
+    
+    for (i = 0; i < nnodes; i++) {
+        
+        arena_t* a = &default_heap.arenas[i];
+        
+        lock_acquire(&a->lock);
+        
+        if (a->remote_frees != NULL) {
+            drain_remote_frees(a);
+        }
+        
+        if (a->deferred != NULL) {
+            drain_deferred(a, false); //purged with the rest below
+        }
+        
+        for (j = -1; j < NBINS; j++) {
+            
+            metadata_t* block = (j < 0) ? a->freelist : a->bins[j];
+            
+            for (; block != NULL; block = block->next) {
+                purged += purge_block(a, block);
+            }
+        }
+        
+        lock_release(&a->lock);
+    }
+    
+    return purged;
+}
+
+/* coalesces what dfree deferred in every arena of every heap; see DMALLOC_DEFER */
+static size_t coalesce_deferred(bool purge) {
+    
+    dheap_t* h;
+    size_t count = 0;
+    int i;
+    
+    //heaps_lock keeps dheap_destroy away, and comes before the arena locks as in dmalloc_prefork
+    
+    pthread_mutex_lock(&heaps_lock);
+    
+    for (h = heaps; h != NULL; h = h->next) {
+        for (i = 0; i < nnodes; i++) {
+            
+            arena_t* a = &h->arenas[i];
+            
+            if (__atomic_load_n(&a->deferred, __ATOMIC_RELAXED) == NULL) {
+                continue;
+            }
+            
+            lock_acquire(&a->lock);
+            count += drain_deferred(a, purge);
+            lock_release(&a->lock);
+        }
+    }
+    
+    pthread_mutex_unlock(&heaps_lock);
+    
+    return count;
+}
+
+size_t dmalloc_coalesce() {
+    
+    pthread_once(&setup_once, setup);
+    
+    return coalesce_deferred(false);
+}
+
+static void* maintenance(void* arg) {
+    
+    struct timespec deadline;
+    
+    pthread_mutex_lock(&maintenance_lock);
+    
+    while (maintenance_running) {
+        
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        
+        long ns = deadline.tv_nsec + (maintenance_ms % 1000) * 1000000;
+        
+        deadline.tv_sec += maintenance_ms / 1000 + ns / 1000000000;
+        deadline.tv_nsec = ns % 1000000000;
+        
+        pthread_cond_timedwait(&maintenance_wake, &maintenance_lock, &deadline);
+        
+        if (!maintenance_running) {
+            break;
+        }
+        
+        pthread_mutex_unlock(&maintenance_lock);
+        
+        //an idle tick stays away from heaps_lock and the arena locks
+        
+        if (__atomic_exchange_n(&deferred_pending, false, __ATOMIC_ACQUIRE)) {
+            coalesce_deferred(true);
+        }
+        
+        pthread_mutex_lock(&maintenance_lock);
+    }
+    
+    pthread_mutex_unlock(&maintenance_lock);
+    
+    return NULL;
+}
+
+void dmalloc_maintenance_stop() {
+    
+    pthread_once(&setup_once, setup);
+    
+    pthread_mutex_lock(&maintenance_lock);
+    
+    bool running = maintenance_running;
+    
+    maintenance_running = false;
+    pthread_cond_signal(&maintenance_wake);
+    
+    pthread_mutex_unlock(&maintenance_lock);
+    
+    if (running) {
+        pthread_join(maintenance_thread, NULL);
+    }
+}
+
+/*
+    Adds up the lock statistics of the default heap: the arena locks in one
+    total, the class locks in the other. The counters are read under each
+    lock but not counted as acquisitions.
+*/
+
+static void add_lock_stats(dmalloc_lock_stats_t* total, dmm_lock_t* l) {
+    
+    pthread_mutex_lock(&l->mutex);
+    
+    total->acquired += l->acquired;
+    total->contended += l->contended;
+    total->wait_ns += l->wait_ns;
+    total->hold_ns += l->hold_ns;
+    
+    pthread_mutex_unlock(&l->mutex);
+}
+
+void dmalloc_lock_stats(dmalloc_lock_stats_t* arena_locks, dmalloc_lock_stats_t* class_locks) {
+    
+    int i, cls;
+    
+    pthread_once(&setup_once, setup);
+    
+    memset(arena_locks, 0, sizeof(*arena_locks));
+    memset(class_locks, 0, sizeof(*class_locks));
+    
+    for (i = 0; i < nnodes; i++) {
+        
+        add_lock_stats(arena_locks, &default_heap.arenas[i].lock);
+        
+        for (cls = 0; cls < SMALL_CLASSES; cls++) {
+            add_lock_stats(class_locks, &default_heap.arenas[i].classes[cls].lock);
+        }
+    }
+}
+
+/* bytes of the default heap's regions that have been committed so far */
+size_t dmalloc_committed() {
+    
+    size_t committed = 0;
+    int i;
+    
+    for (i = 0; i < nnodes; i++) {
+        arena_t* a = &default_heap.arenas[i];
+        
+        if (a->head != NULL) {
+            committed += a->committed - (((void*) a->head) - REGION_PAD);
+        }
+    }
+    
+    return committed;
+}
+
+/*Only for debugging purposes; can be turned off through -NDEBUG flag*/
+void print_freelist() {
+    int i, j;
+    for (j = 0; j < nnodes; j++) {
+        for (i = -1; i < NBINS; i++) {
+            metadata_t *freelist_head = (i < 0) ? default_heap.arenas[j].freelist : default_heap.arenas[j].bins[i];
+            while(freelist_head != NULL) {
+                DEBUG("\tFreelist Size:%zd, Head:%p, Prev:%p, Next:%p\t",freelist_head->size,freelist_head,freelist_head->prev,freelist_head->next);
+                freelist_head = freelist_head->next;
+            }
+        }
+    }
+    DEBUG("\n");
+    
+}
@@ -1,11 +1,14 @@
 #ifndef __CPS210_MM_H__ 	/* check if this header file is already defined elsewhere */
 #define __CPS210_MM_H__
 
+#include <stdio.h> //for FILE and the DEBUG macro
 
 /* You do not need to change MAX_HEAP_SIZE 
  */
 //#define MAX_HEAP_SIZE	(1024*1024*32) /* max size restricted to 32 MB */
+#ifndef MAX_HEAP_SIZE /* can be overridden from the build, see libdmm.so in the Makefile */
 #define MAX_HEAP_SIZE	(1024*1024*4) /* max size restricted to 4MB, recommended setting for test_stress2 */
+#endif
 //define MAX_HEAP_SIZE	(1024) /* max size restricted to 1kB*/
 
 /* On 32-bit machines, change this to 4 */
@@ -20,6 +23,10 @@
 
 #define SIZE_T_ALIGNED (ALIGN(sizeof(size_t)))
 
+/* what dmalloc aligns payloads to; like malloc, enough for any basic type */
+#define DMALLOC_ALIGNMENT 16
+#define PAYLOAD_ALIGN(size) (((size) + (DMALLOC_ALIGNMENT-1)) & ~(DMALLOC_ALIGNMENT-1))
+
 #define METADATA_T_ALIGNED (ALIGN(sizeof(metadata_t)))
 
 #ifdef NDEBUG
@@ -30,13 +37,134 @@
 	#define PRINT_FREELIST
 #endif
 
+#ifdef __cplusplus
+/* C++ has its own bool, which the C enum below is passed and returned like
+ * as long as it only ever holds 0 or 1; see dmm.hpp for the C++ interface.
+ */
+extern "C" {
+#else
 typedef enum{false, true} bool;
+#endif
+
+/* How dmalloc looks up free blocks. ADAPTIVE (the default) starts with the
+ * single first-fit list and switches to segregated bins when the average
+ * search gets long, and back once few free blocks are left. ADDRESS_ORDERED
+ * keeps the single list sorted by address and takes the lowest block that
+ * fits, which fragments least on long-running heaps.
+ */
+typedef enum{DMM_POLICY_ADAPTIVE, DMM_POLICY_FIRST_FIT, DMM_POLICY_SEGREGATED, DMM_POLICY_ADDRESS_ORDERED} dmm_policy_t;
 
 bool dmalloc_init();
 void *dmalloc(size_t numbytes);
 void dfree(void *allocptr);
 
+/* Separate heaps, e.g. one per component, each with its own arenas and
+ * locality. dmalloc and dfree use a default heap of MAX_HEAP_SIZE bytes;
+ * dheap_destroy frees a whole heap, blocks still in use included.
+ */
+typedef struct dheap dheap_t;
+
+dheap_t *dheap_create(size_t size); /* size in bytes per NUMA node */
+void *dheap_alloc(dheap_t *heap, size_t numbytes);
+void dheap_free(dheap_t *heap, void *allocptr);
+void dheap_destroy(dheap_t *heap);
+
+/* Fixed-size requests. Most call sites pass a constant such as
+ * sizeof(struct node); DMALLOC_FIXED(n) resolves the size class of a
+ * constant n of at most DMALLOC_SMALL_MAX bytes at compile time and calls
+ * dmalloc_small, which pops that class of the per-CPU cache or class list
+ * directly (DMALLOC_PERCPU, DMALLOC_CLASS_LOCKS) and only takes the general
+ * path on a miss. Any other n compiles to dmalloc(n). The block comes from
+ * the default heap and is released with dfree; in C++ see dmm::dmalloc<N>().
+ */
+#define DMALLOC_SMALL_MAX 256
+#define DMALLOC_SMALL_CLASS(n) ((int) (((n) - 1) / 16)) /* payloads of 16, 32, ... bytes */
+
+#define DMALLOC_FIXED(n) \
+	((__builtin_constant_p(n) && (n) > 0 && (n) <= DMALLOC_SMALL_MAX) \
+		? dmalloc_small(DMALLOC_SMALL_CLASS(n)) : dmalloc(n))
+
+void *dmalloc_small(int cls); /* a block of (cls + 1) * 16 bytes */
+
+/* Shared heaps for cooperating processes, see dmm_shared.c. With a name
+ * (e.g. "/workers") the heap is a POSIX shared memory object that other
+ * processes attach with dshm_open and that lives until shm_unlink(name);
+ * without one it is an anonymous memfd shared with the children forked
+ * afterwards. Blocks are handed between processes as offsets.
+ */
+typedef struct dshm dshm_t;
+
+dshm_t *dshm_create(const char *name, size_t size);
+dshm_t *dshm_open(const char *name);
+void dshm_close(dshm_t *heap); /* unmaps the heap in this process only */
+void *dshm_alloc(dshm_t *heap, size_t numbytes);
+void dshm_free(dshm_t *heap, void *allocptr);
+size_t dshm_offset(dshm_t *heap, void *ptr); /* 0 for NULL */
+void *dshm_pointer(dshm_t *heap, size_t offset);
+
+/* Persistent heaps: a shared heap in a regular file that a restarted
+ * process opens again with everything in place. The root is where the
+ * process keeps the way back to its data; store offsets, not pointers,
+ * inside the heap, since the file may be mapped elsewhere next time.
+ */
+dshm_t *dshm_open_file(const char *path, size_t size); /* size only counts for a new file */
+void *dshm_root(dshm_t *heap);
+void dshm_set_root(dshm_t *heap, void *ptr);
+bool dshm_sync(dshm_t *heap); /* msync, for machine crashes; process crashes need nothing */
+
+void *dmemalign(size_t alignment, size_t numbytes); /* alignment must be a power of two */
+size_t dmalloc_usable_size(void *ptr);
+bool dmalloc_owns(void *ptr); /* whether ptr points into the heap */
+const char *dmalloc_backend(); /* "dmm", or the DMALLOC_BACKEND serving dmalloc, e.g. "redo" */
+size_t dmalloc_purge(); /* returns the pages of free blocks to the kernel */
+size_t dmalloc_committed(); /* bytes of the heap reservation made accessible so far */
+size_t dmalloc_quarantine_flush(); /* see DMALLOC_QUARANTINE in dmm.c; returns the blocks checked */
+size_t dmalloc_coalesce(); /* see DMALLOC_DEFER in dmm.c; returns the blocks coalesced */
+void dmalloc_maintenance_stop(); /* stops the DMALLOC_DEFER_INTERVAL thread, if any, and waits for it */
+
+/* Lock statistics, see DMALLOC_CLASS_LOCKS and DMALLOC_LOCK_STATS in dmm.c.
+ * hold_ns stays 0 unless DMALLOC_LOCK_STATS=1.
+ */
+typedef struct dmalloc_lock_stats {
+	unsigned long acquired;
+	unsigned long contended;
+	unsigned long long wait_ns;
+	unsigned long long hold_ns;
+} dmalloc_lock_stats_t;
+
+void dmalloc_lock_stats(dmalloc_lock_stats_t *arena_locks, dmalloc_lock_stats_t *class_locks);
+
+/* pthread_atfork handlers, registered by the heap on first use */
+void dmalloc_prefork();
+void dmalloc_postfork_parent();
+void dmalloc_postfork_child();
+
+/* dmalloc and dfree are not async-signal-safe. A thread that needs to
+ * allocate from a signal handler reserves a private pool beforehand;
+ * dmalloc_emergency is async-signal-safe and never returns memory to dfree.
+ */
+bool dmalloc_emergency_reserve(size_t numbytes);
+void *dmalloc_emergency(size_t numbytes);
+
 
 void print_freelist(); /* optional for debugging */
 
+void dmalloc_set_policy(dmm_policy_t policy);
+size_t dmalloc_search_average(); /* moving average of free blocks inspected per dmalloc */
+
+/* Heap walk: calls back once per physical block, used or free, in address order */
+typedef void (*dmalloc_walker_t)(void* ptr, size_t size, bool used, void* arg);
+void dmalloc_walk(dmalloc_walker_t callback, void* arg);
+
+/* Sampling heap profiler, see dmm_prof.c. The rate is the mean number of
+ * bytes allocated between two samples; 0 (the default) turns sampling off.
+ * It can also be set through the DMALLOC_PROF_RATE environment variable.
+ */
+void dmalloc_prof_set_rate(size_t rate);
+bool dmalloc_prof_dump(FILE* out); /* pprof heap profile of the live samples */
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* end of __CPS210_MM_H__ */
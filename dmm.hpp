@@ -0,0 +1,102 @@
+#ifndef __DMM_HPP__
+#define __DMM_HPP__
+
+#include <cstddef>
+#include <new> //for std::bad_alloc
+#include <memory_resource>
+
+#include "dmm.h"
+
+/*
+    C++ interface to the heap manager.
+
+    dmm::allocator<T> plugs into any standard container, and
+    dmm::memory_resource into the std::pmr ones. Both throw std::bad_alloc
+    when the heap is exhausted instead of falling back to another allocator.
+    To route plain new and delete to the heap as well, link dmm_new.o, which
+    replaces the global operator new and delete, sized and aligned forms
+    included.
+*/
+
+namespace dmm {
+
+/* requests with an alignment above DMALLOC_ALIGNMENT go through dmemalign */
+inline void* allocate(std::size_t bytes, std::size_t alignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    void* ptr = (alignment <= DMALLOC_ALIGNMENT) ? dmalloc(bytes ? bytes : 1) : dmemalign(alignment, bytes ? bytes : 1);
+
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+inline void deallocate(void* ptr) noexcept {
+    if (ptr != nullptr) {
+        dfree(ptr);
+    }
+}
+
+/* dmm::dmalloc<sizeof(T)>() is DMALLOC_FIXED for C++; release with dfree */
+template <std::size_t N>
+inline void* dmalloc() {
+    static_assert(N > 0, "dmm::dmalloc<0>() has no size class");
+
+    if constexpr (N <= DMALLOC_SMALL_MAX) {
+        return dmalloc_small(DMALLOC_SMALL_CLASS(N));
+    } else {
+        return ::dmalloc(N);
+    }
+}
+
+template <typename T>
+class allocator {
+public:
+    typedef T value_type;
+
+    allocator() noexcept {}
+
+    template <typename U>
+    allocator(const allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        if (n > static_cast<std::size_t>(-1) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(dmm::allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept {
+        dmm::deallocate(ptr); // the block header knows the size
+    }
+
+    template <typename U>
+    bool operator==(const allocator<U>&) const noexcept { return true; }
+
+    template <typename U>
+    bool operator!=(const allocator<U>&) const noexcept { return false; }
+};
+
+class memory_resource : public std::pmr::memory_resource {
+protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        return dmm::allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* ptr, std::size_t, std::size_t) override {
+        dmm::deallocate(ptr);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return dynamic_cast<const memory_resource*>(&other) != nullptr; // there is only one heap
+    }
+};
+
+/* a process-wide instance, e.g. for std::pmr::set_default_resource */
+inline memory_resource* heap_resource() noexcept {
+    static memory_resource resource;
+    return &resource;
+}
+
+} // namespace dmm
+
+#endif /* end of __DMM_HPP__ */
@@ -0,0 +1,31 @@
+#ifndef __DMM_BACKEND_H__
+#define __DMM_BACKEND_H__
+
+#include "dmm.h"
+
+/*
+    Internal interface between dmm.c and the other allocator engines.
+
+    dmalloc, dfree, dmalloc_init, dmalloc_owns and dmalloc_usable_size go
+    through the backend picked with DMALLOC_BACKEND when the process starts.
+    Everything else (separate heaps, dmemalign, size classes, purging, the
+    walker and the statistics) belongs to the heap in dmm.c, whichever backend
+    is selected, so dfree hands each pointer to the backend that owns it.
+*/
+
+typedef struct dmm_backend {
+    const char* name; // as given in DMALLOC_BACKEND
+    bool (*init)();
+    void* (*alloc)(size_t numbytes);
+    void (*free)(void* ptr);
+    bool (*owns)(void* ptr);
+    size_t (*usable_size)(void* ptr);
+} dmm_backend_t;
+
+extern const dmm_backend_t dmm_redo_backend; // the sorted free list from dmm_redo.c
+
+/* reports an invalid free or a corrupted heap on stderr and aborts, for every backend */
+__attribute__((noreturn, cold))
+void dmm_heap_abort(const char* what, void* block);
+
+#endif /* end of __DMM_BACKEND_H__ */
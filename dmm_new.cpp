@@ -0,0 +1,129 @@
+#include <new>
+
+#include "dmm.hpp"
+#include "dmm_prof.h"
+
+/*
+    Replacement global operator new and delete. Link this object into a
+    program to have every new expression served by the heap manager. The
+    throwing forms follow the standard: retry through the installed
+    new_handler, and throw std::bad_alloc when there is none. The forms
+    without an alignment still owe __STDCPP_DEFAULT_NEW_ALIGNMENT__.
+*/
+
+DMM_PROF_FRAME
+static void* new_block(std::size_t size, std::size_t alignment) {
+
+    for (;;) {
+        void* ptr = (alignment <= DMALLOC_ALIGNMENT) ? dmalloc(size ? size : 1) : dmemalign(alignment, size ? size : 1);
+
+        if (ptr != nullptr) {
+            return ptr;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+DMM_PROF_FRAME
+static void* new_block_nothrow(std::size_t size, std::size_t alignment) noexcept {
+    try {
+        return new_block(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+DMM_PROF_FRAME
+void* operator new(std::size_t size) {
+    return new_block(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+DMM_PROF_FRAME
+void* operator new[](std::size_t size) {
+    return new_block(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+DMM_PROF_FRAME
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return new_block_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+DMM_PROF_FRAME
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return new_block_nothrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+DMM_PROF_FRAME
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return new_block(size, static_cast<std::size_t>(alignment));
+}
+
+DMM_PROF_FRAME
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return new_block(size, static_cast<std::size_t>(alignment));
+}
+
+DMM_PROF_FRAME
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return new_block_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+DMM_PROF_FRAME
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return new_block_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+/* every delete ends up in dfree, which finds the size in the block header */
+
+void operator delete(void* ptr) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    dmm::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    dmm::deallocate(ptr);
+}
@@ -0,0 +1,174 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <sys/mman.h> //for the cache array
+#include <sys/sysinfo.h> //for get_nprocs_conf
+#include "dmm_percpu.h"
+
+/*
+    Per-CPU caches on top of Linux restartable sequences.
+
+    glibc registers a struct rseq for every thread at __rseq_offset from the
+    thread pointer; the kernel keeps its cpu_id field current. A restartable
+    sequence is a short stretch of code described by a struct rseq_cs: if the
+    thread is preempted, migrated or signalled while its instruction pointer
+    is inside [start_ip, start_ip + post_commit_offset), the kernel moves it
+    to abort_ip instead of resuming. So a sequence that reads this CPU's
+    cache, checks cpu_id and ends in a single committing store either runs
+    as a whole on one CPU or not at all, and we simply retry after an abort.
+
+    The sequences are written in x86-64 assembly, after the layout librseq
+    uses. Elsewhere, or with -DDMM_NO_RSEQ, dmm_percpu_init reports that the
+    caches are unavailable and dmm.c never calls the other two functions.
+*/
+
+#if !defined(DMM_NO_RSEQ) && defined(__x86_64__) && defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define DMM_HAVE_RSEQ
+#endif
+#endif
+
+typedef struct cpu_cache {
+    unsigned long count[SMALL_CLASSES];
+    void* slots[SMALL_CLASSES][PERCPU_SLOTS];
+} cpu_cache_t;
+
+static cpu_cache_t* caches = NULL;
+static unsigned int ncpus = 0;
+
+#ifdef DMM_HAVE_RSEQ
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+/*
+    The descriptor goes to __rseq_cs, the abort handler to __rseq_failure,
+    preceded by the signature the kernel checks before jumping there. Labels:
+    1 start, 2 post-commit, 3 descriptor, 4 abort.
+*/
+#define RSEQ_PROLOGUE \
+    ".pushsection __rseq_cs, \"aw\"\n\t" \
+    ".balign 32\n\t" \
+    "3:\n\t" \
+    ".long 0x0, 0x0\n\t" \
+    ".quad 1f, (2f - 1f), 4f\n\t" \
+    ".popsection\n\t" \
+    "leaq 3b(%%rip), %%rax\n\t" \
+    "movq %%rax, %%fs:8(%[rseq_offset])\n\t" \
+    "1:\n\t" \
+    "cmpl %[cpu], %%fs:4(%[rseq_offset])\n\t" \
+    "jnz 4f\n\t"
+
+#define RSEQ_EPILOGUE \
+    "2:\n\t" \
+    ".pushsection __rseq_failure, \"ax\"\n\t" \
+    ".byte 0x0f, 0xb9, 0x3d\n\t" \
+    ".long " STR(RSEQ_SIG) "\n\t" \
+    "4:\n\t" \
+    "jmp %l[abort]\n\t" \
+    ".popsection\n\t"
+
+static inline unsigned int current_cpu() {
+    return ((volatile struct rseq*) ((char*) __builtin_thread_pointer() + __rseq_offset))->cpu_id_start;
+}
+
+void* dmm_percpu_pop(int cls) {
+    
+    void* ptr;
+    
+abort:
+    {
+        unsigned int cpu = current_cpu();
+        cpu_cache_t* cache = &caches[cpu];
+        
+        asm goto (
+            RSEQ_PROLOGUE
+            "movq (%[count]), %%rcx\n\t"
+            "testq %%rcx, %%rcx\n\t"
+            "jz %l[empty]\n\t"
+            "movq -8(%[slots], %%rcx, 8), %%rdx\n\t"
+            "movq %%rdx, (%[ptr])\n\t"
+            "decq %%rcx\n\t"
+            "movq %%rcx, (%[count])\n\t" // commit
+            RSEQ_EPILOGUE
+            :
+            : [rseq_offset] "r" (__rseq_offset), [cpu] "r" (cpu),
+              [count] "r" (&cache->count[cls]), [slots] "r" (cache->slots[cls]), [ptr] "r" (&ptr)
+            : "rax", "rcx", "rdx", "memory", "cc"
+            : abort, empty);
+        
+        return ptr;
+    }
+    
+empty:
+    return NULL;
+}
+
+bool dmm_percpu_push(int cls, void* ptr) {
+    
+abort:
+    {
+        unsigned int cpu = current_cpu();
+        cpu_cache_t* cache = &caches[cpu];
+        
+        asm goto (
+            RSEQ_PROLOGUE
+            "movq (%[count]), %%rcx\n\t"
+            "cmpq %[nslots], %%rcx\n\t"
+            "jae %l[full]\n\t"
+            "movq %[ptr], (%[slots], %%rcx, 8)\n\t"
+            "incq %%rcx\n\t"
+            "movq %%rcx, (%[count])\n\t" // commit
+            RSEQ_EPILOGUE
+            :
+            : [rseq_offset] "r" (__rseq_offset), [cpu] "r" (cpu),
+              [count] "r" (&cache->count[cls]), [slots] "r" (cache->slots[cls]), [ptr] "r" (ptr),
+              [nslots] "i" (PERCPU_SLOTS)
+            : "rax", "rcx", "memory", "cc"
+            : abort, full);
+        
+        return true;
+    }
+    
+full:
+    return false;
+}
+
+/* the caches are mapped lazily by the kernel, so idle CPUs cost no memory */
+bool dmm_percpu_init() {
+    
+    if (caches != NULL) {
+        return true;
+    }
+    
+    if (__rseq_size == 0) {
+        return false; // rseq unsupported, or disabled through glibc.pthread.rseq
+    }
+    
+    ncpus = (unsigned int) get_nprocs_conf();
+    
+    void* mem = mmap(NULL, ncpus * sizeof(cpu_cache_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    
+    caches = (cpu_cache_t*) mem;
+    return true;
+}
+
+#else
+
+void* dmm_percpu_pop(int cls) {
+    return NULL;
+}
+
+bool dmm_percpu_push(int cls, void* ptr) {
+    return false;
+}
+
+bool dmm_percpu_init() {
+    return false;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef __DMM_PERCPU_H__
+#define __DMM_PERCPU_H__
+
+#include "dmm.h"
+
+/*
+    Internal interface between dmm.c and the per-CPU caches.
+
+    Every CPU keeps a small stack of free blocks per size class. Pushing and
+    popping run as restartable sequences on the caller's current CPU, so they
+    need neither locks nor atomic instructions. The caches only hold blocks;
+    refilling them from and flushing them to the arenas is left to dmm.c.
+*/
+
+#define SMALL_CLASSES (DMALLOC_SMALL_MAX / 16) /* payloads of 16, 32, ... 256 bytes */
+#define SMALL_CLASS_SIZE(cls) (((size_t) (cls) + 1) * 16)
+#define SMALL_MAX_SIZE SMALL_CLASS_SIZE(SMALL_CLASSES - 1)
+#define PERCPU_SLOTS 32 /* blocks per class and CPU */
+
+bool dmm_percpu_init(); // false when the kernel or libc offer no rseq
+void* dmm_percpu_pop(int cls); // NULL when this CPU has none cached
+bool dmm_percpu_push(int cls, void* ptr); // false when this CPU's stack is full
+
+#endif /* end of __DMM_PERCPU_H__ */
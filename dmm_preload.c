@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stddef.h> //for max_align_t
+#include <stdlib.h>
+#include <string.h> //for memcpy and memset
+#include <errno.h>
+#include <unistd.h> //for sysconf
+#include <malloc.h> //for the memalign family prototypes
+#include "dmm.h"
+#include "dmm_prof.h"
+
+/*
+    LD_PRELOAD shim: exports the standard malloc family on top of the heap
+    manager, so unmodified programs can run on it:
+
+        LD_PRELOAD=./libdmm.so ./some_program
+
+    Two situations cannot be served by dmalloc itself and fall back to a small
+    static bootstrap arena instead:
+     - re-entry: the heap profiler calls backtrace(), which may load libgcc
+       and allocate while this thread already holds the heap lock, and a
+       signal handler may call malloc while the thread it interrupted is
+       inside the heap;
+     - allocations made before our constructor has run, e.g. by the dynamic
+       loader while it sets up TLS for other libraries.
+    Bootstrap blocks are never reused; free() simply ignores them. Every
+    other block in the process comes from the heap manager, so any other
+    pointer goes to dfree, which aborts on the ones it does not own.
+*/
+
+#define BOOTSTRAP_SIZE (1024*1024)
+#define BOOTSTRAP_ALIGN 16
+#define MALLOC_ALIGNMENT _Alignof(max_align_t) /* malloc's blocks must suit any basic type */
+
+typedef struct bootstrap_header {
+    size_t size;
+    size_t pad; // keeps the payload 16-byte aligned
+} bootstrap_header_t;
+
+static char bootstrap_arena[BOOTSTRAP_SIZE] __attribute__((aligned(BOOTSTRAP_ALIGN)));
+static size_t bootstrap_used = 0;
+
+static bool ready = false;
+
+/* initial-exec TLS lives in the static TLS block and never allocates */
+static __thread int in_dmm __attribute__((tls_model("initial-exec")));
+
+static void* bootstrap_alloc(size_t alignment, size_t size) {
+
+    size_t need = ALIGN(size) + sizeof(bootstrap_header_t) + alignment;
+    size_t start = __atomic_fetch_add(&bootstrap_used, need, __ATOMIC_RELAXED);
+
+    if (start + need > BOOTSTRAP_SIZE) {
+        return NULL;
+    }
+
+    size_t payload = (((size_t) bootstrap_arena) + start + sizeof(bootstrap_header_t) + alignment - 1) & ~(alignment - 1);
+
+    ((bootstrap_header_t*) payload)[-1].size = size;
+
+    return (void*) payload;
+}
+
+static bool is_bootstrap(void* ptr) {
+    return ((char*) ptr >= bootstrap_arena && (char*) ptr < bootstrap_arena + BOOTSTRAP_SIZE) ? true : false;
+}
+
+DMM_PROF_FRAME
+static void* shim_alloc(size_t alignment, size_t size) {
+
+    void* ptr;
+
+    if (size == 0) {
+        size = 1; // malloc(0) must return a unique pointer
+    }
+
+    if (!ready || in_dmm) {
+        ptr = bootstrap_alloc(alignment < BOOTSTRAP_ALIGN ? BOOTSTRAP_ALIGN : alignment, size);
+    } else {
+        in_dmm = 1;
+        ptr = (alignment <= DMALLOC_ALIGNMENT) ? dmalloc(size) : dmemalign(alignment, size);
+        in_dmm = 0;
+    }
+
+    if (ptr == NULL) {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+static size_t shim_usable_size(void* ptr) {
+
+    if (is_bootstrap(ptr)) {
+        return ((bootstrap_header_t*) ptr)[-1].size;
+    }
+    if (dmalloc_owns(ptr)) {
+        return dmalloc_usable_size(ptr);
+    }
+    return 0; // not ours, the size is unknown
+}
+
+DMM_PROF_FRAME
+void* malloc(size_t size) {
+    return shim_alloc(MALLOC_ALIGNMENT, size);
+}
+
+void free(void* ptr) {
+
+    if (ptr == NULL || is_bootstrap(ptr)) {
+        return;
+    }
+
+    in_dmm = 1;
+    dfree(ptr);
+    in_dmm = 0;
+}
+
+DMM_PROF_FRAME
+void* calloc(size_t nmemb, size_t size) {
+
+    size_t total;
+
+    if (__builtin_mul_overflow(nmemb, size, &total)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void* ptr = shim_alloc(MALLOC_ALIGNMENT, total);
+
+    if (ptr != NULL && !is_bootstrap(ptr)) {
+        memset(ptr, 0, total); // the bootstrap arena is fresh zeroed memory
+    }
+    return ptr;
+}
+
+DMM_PROF_FRAME
+void* realloc(void* ptr, size_t size) {
+
+    if (ptr == NULL) {
+        return malloc(size);
+    }
+
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    if (!is_bootstrap(ptr) && !dmalloc_owns(ptr)) {
+        free(ptr); // not a block at all; dfree reports it and aborts
+    }
+
+    size_t old_size = shim_usable_size(ptr);
+
+    if (size <= old_size && !is_bootstrap(ptr)) {
+        return ptr;
+    }
+
+    void* new_ptr = malloc(size);
+
+    if (new_ptr != NULL) {
+        memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+        free(ptr);
+    }
+    return new_ptr;
+}
+
+DMM_PROF_FRAME
+void* reallocarray(void* ptr, size_t nmemb, size_t size) {
+
+    size_t total;
+
+    if (__builtin_mul_overflow(nmemb, size, &total)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(ptr, total);
+}
+
+DMM_PROF_FRAME
+void* memalign(size_t alignment, size_t size) {
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return shim_alloc(alignment, size);
+}
+
+DMM_PROF_FRAME
+int posix_memalign(void** memptr, size_t alignment, size_t size) {
+
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+
+    void* ptr = shim_alloc(alignment, size);
+
+    if (ptr == NULL) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+DMM_PROF_FRAME
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+DMM_PROF_FRAME
+void* valloc(size_t size) {
+    return shim_alloc((size_t) sysconf(_SC_PAGESIZE), size);
+}
+
+DMM_PROF_FRAME
+void* pvalloc(size_t size) {
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+    return shim_alloc(page, (size + page - 1) & ~(page - 1));
+}
+
+size_t malloc_usable_size(void* ptr) {
+    return (ptr == NULL) ? 0 : shim_usable_size(ptr);
+}
+
+__attribute__((constructor))
+static void dmm_preload_init() {
+    ready = true; // the heap registers its own fork handlers on first use
+}
@@ -0,0 +1,327 @@
+#define _GNU_SOURCE //for the recursive mutex initializer
+#include <stdio.h>
+#include <stdlib.h> //for getenv and strtoull
+#include <stdint.h> //for uintptr_t
+#include <limits.h> //for LLONG_MAX
+#include <math.h> //for log
+#include <execinfo.h> //for backtrace
+#include <pthread.h> //for the table lock
+#include <sys/mman.h> //for the table
+#include "dmm_prof.h"
+
+/*
+    Sampling heap profiler.
+
+    Allocations are sampled in proportion to their size: the number of bytes
+    between two samples is drawn from an exponential distribution with mean
+    prof_rate (the continuous form of a geometric distribution over bytes),
+    which is the model pprof assumes when it scales samples back up to totals.
+
+    For every sample we capture a backtrace and store it in an open
+    addressing table keyed by the user pointer. The table is mmap'ed and
+    doubles whenever it gets three quarters full. Nothing here calls dmalloc,
+    so recording a sample can never recurse into the allocator. dmalloc marks the
+    sampled block in its header, and dfree only calls dmm_prof_forget for
+    blocks carrying that mark.
+*/
+
+#define PROF_TABLE_INITIAL 1024 /* slots; the table stays a power of two */
+#define PROF_MAX_LIVE(size) ((size) - (size)/4) /* keep probe chains short */
+#define PROF_MAX_DEPTH 32
+#define PROF_MAX_SKIP 16 /* allocator frames a backtrace may start with, see DMM_PROF_FRAME */
+#define PROF_RECHECK (64LL*1024*1024) /* bytes between rate checks while sampling is off */
+
+typedef struct prof_record {
+    void* ptr; // NULL marks an empty slot
+    size_t size; // requested size, not the aligned one
+    int depth;
+    void* stack[PROF_MAX_DEPTH];
+} prof_record_t;
+
+/*
+    Each thread counts down on its own, so the arenas never share a hot
+    counter. The table, the generator and the rate are shared and guarded by
+    prof_lock, which only sampled allocations and frees take. It is recursive
+    because backtrace may allocate the first time it runs, and get sampled,
+    when we are the process's malloc.
+
+    dfree takes prof_lock with an arena lock held, so nothing may allocate
+    while holding prof_lock on another thread's behalf: dmalloc_prof_dump
+    copies the records out and does its stdio after unlocking.
+*/
+__thread long long dmm_prof_countdown __attribute__((tls_model("initial-exec"))) = 0;
+
+static pthread_mutex_t prof_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static size_t prof_rate = 0; // mean bytes between samples, 0 disables sampling
+static size_t prof_period = 0; // last non-zero rate, reported in the dump
+static unsigned long long prof_rng = 0x9E3779B97F4A7C15ULL;
+static prof_record_t* prof_table = NULL;
+static size_t prof_table_size = 0; // slots, 0 until the first sample
+static size_t prof_live = 0;
+static size_t prof_dropped = 0; // samples lost because the table could not grow
+
+extern char __start_dmm_frames[], __stop_dmm_frames[]; // from the linker, see DMM_PROF_FRAME
+
+/*
+    xorshift64*; we keep our own generator so that turning the profiler on
+    does not disturb random() sequences of the program being profiled.
+*/
+static double prof_uniform() {
+    prof_rng ^= prof_rng >> 12;
+    prof_rng ^= prof_rng << 25;
+    prof_rng ^= prof_rng >> 27;
+    return ((prof_rng * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0); // [0, 1)
+}
+
+static long long prof_next_interval() {
+    if (prof_rate == 0) {
+        return PROF_RECHECK; // other threads still need to notice a new rate
+    }
+
+    double gap = -log(1.0 - prof_uniform()) * (double) prof_rate;
+
+    if (gap >= (double) (LLONG_MAX / 2)) {
+        return LLONG_MAX / 2;
+    }
+    return (long long) gap;
+}
+
+static size_t prof_slot(void* ptr) {
+    return (size_t) ((((uintptr_t) ptr) >> 3) * 0x9E3779B97F4A7C15ULL >> 32) & (prof_table_size - 1);
+}
+
+/* with prof_lock held; moves every record into a table twice the size */
+static bool prof_grow() {
+    size_t old_size = prof_table_size;
+    prof_record_t* old_table = prof_table;
+    size_t new_size = old_size ? 2 * old_size : PROF_TABLE_INITIAL;
+
+    prof_record_t* table = mmap(NULL, new_size * sizeof(prof_record_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (table == MAP_FAILED) {
+        return false;
+    }
+
+    prof_table = table;
+    prof_table_size = new_size;
+
+    for (size_t i = 0; i < old_size; i++) {
+        if (old_table[i].ptr != NULL) {
+            size_t slot = prof_slot(old_table[i].ptr);
+            while (prof_table[slot].ptr != NULL) {
+                slot = (slot + 1) & (prof_table_size - 1);
+            }
+            prof_table[slot] = old_table[i];
+        }
+    }
+
+    if (old_table != NULL) {
+        munmap(old_table, old_size * sizeof(prof_record_t));
+    }
+    return true;
+}
+
+static bool prof_own_frame(void* pc) {
+    return ((char*) pc >= __start_dmm_frames && (char*) pc < __stop_dmm_frames) ? true : false;
+}
+
+void dmm_prof_init() {
+    char* rate = getenv("DMALLOC_PROF_RATE");
+
+    if (rate != NULL) {
+        dmalloc_prof_set_rate((size_t) strtoull(rate, NULL, 10));
+    }
+}
+
+void dmalloc_prof_set_rate(size_t rate) {
+    pthread_mutex_lock(&prof_lock);
+    prof_rate = rate;
+    if (rate != 0) {
+        prof_period = rate;
+    }
+    dmm_prof_countdown = prof_next_interval();
+    pthread_mutex_unlock(&prof_lock);
+}
+
+DMM_PROF_FRAME
+bool dmm_prof_sample(void* ptr, size_t numbytes) {
+    void* stack[PROF_MAX_DEPTH + PROF_MAX_SKIP];
+
+    pthread_mutex_lock(&prof_lock);
+
+    dmm_prof_countdown = prof_next_interval();
+
+    if (prof_rate == 0) {
+        pthread_mutex_unlock(&prof_lock);
+        return false; // the countdown ran out only because sampling is off
+    }
+
+    if (prof_live >= PROF_MAX_LIVE(prof_table_size) && !prof_grow()) {
+        prof_dropped++;
+        pthread_mutex_unlock(&prof_lock);
+        return false;
+    }
+
+    int frames = backtrace(stack, PROF_MAX_DEPTH + PROF_MAX_SKIP);
+    int skip = 0;
+
+    while (skip < frames && prof_own_frame(stack[skip])) {
+        skip++;
+    }
+
+    size_t slot = prof_slot(ptr);
+    while (prof_table[slot].ptr != NULL) {
+        slot = (slot + 1) & (prof_table_size - 1);
+    }
+
+    prof_record_t* rec = &prof_table[slot];
+    rec->ptr = ptr;
+    rec->size = numbytes;
+    rec->depth = (frames - skip < PROF_MAX_DEPTH) ? frames - skip : PROF_MAX_DEPTH;
+    for (int i = 0; i < rec->depth; i++) {
+        rec->stack[i] = stack[i + skip];
+    }
+
+    prof_live++;
+    pthread_mutex_unlock(&prof_lock);
+    return true;
+}
+
+/*
+    The fork handlers hold prof_lock across fork(). A recursive mutex
+    remembers its owner's thread id, which the child does not share, so the
+    child gets a fresh lock instead of an unlock.
+*/
+void dmm_prof_prefork() {
+    pthread_mutex_lock(&prof_lock);
+}
+
+void dmm_prof_postfork_parent() {
+    pthread_mutex_unlock(&prof_lock);
+}
+
+void dmm_prof_postfork_child() {
+    pthread_mutex_t fresh = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+    prof_lock = fresh;
+}
+
+/*
+    Linear probing with backward-shift deletion: after emptying a slot we pull
+    later entries of the same probe chain back, so lookups never need
+    tombstones.
+*/
+void dmm_prof_forget(void* ptr) {
+    pthread_mutex_lock(&prof_lock);
+
+    if (prof_table == NULL) {
+        pthread_mutex_unlock(&prof_lock);
+        return; // nothing was ever recorded
+    }
+
+    size_t slot = prof_slot(ptr);
+
+    while (prof_table[slot].ptr != ptr) {
+        if (prof_table[slot].ptr == NULL) {
+            pthread_mutex_unlock(&prof_lock);
+            return; // not recorded
+        }
+        slot = (slot + 1) & (prof_table_size - 1);
+    }
+
+    size_t hole = slot;
+    slot = (slot + 1) & (prof_table_size - 1);
+
+    while (prof_table[slot].ptr != NULL) {
+        size_t home = prof_slot(prof_table[slot].ptr);
+
+        // move the entry into the hole unless its home lies cyclically in (hole, slot]
+        if (((slot - home) & (prof_table_size - 1)) >= ((slot - hole) & (prof_table_size - 1))) {
+            prof_table[hole] = prof_table[slot];
+            hole = slot;
+        }
+        slot = (slot + 1) & (prof_table_size - 1);
+    }
+
+    prof_table[hole].ptr = NULL;
+    prof_live--;
+    pthread_mutex_unlock(&prof_lock);
+}
+
+/*
+    Writes the live samples in the legacy "heap_v2" text format understood by
+    pprof, followed by the memory map it needs for symbolization:
+
+        heap profile: <objs>: <bytes> [<objs>: <bytes>] @ heap_v2/<rate>
+        # <n> samples dropped          (only if the table could not grow)
+        1: <bytes> [1: <bytes>] @ <pc> <pc> ...
+        MAPPED_LIBRARIES:
+        <contents of /proc/self/maps>
+*/
+bool dmalloc_prof_dump(FILE* out) {
+    prof_record_t* records = NULL;
+    size_t live, dropped, period, bytes = 0;
+    size_t live_bytes = 0;
+    size_t i, n = 0;
+    int j;
+
+    pthread_mutex_lock(&prof_lock);
+
+    live = prof_live;
+    dropped = prof_dropped;
+    period = prof_period ? prof_period : 1;
+
+    if (live != 0) {
+        bytes = live * sizeof(prof_record_t);
+        records = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (records == MAP_FAILED) {
+            pthread_mutex_unlock(&prof_lock);
+            return false;
+        }
+
+        for (i = 0; i < prof_table_size; i++) {
+            if (prof_table[i].ptr != NULL) {
+                records[n++] = prof_table[i];
+                live_bytes += prof_table[i].size;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&prof_lock);
+
+    fprintf(out, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+            live, live_bytes, live, live_bytes, period);
+
+    if (dropped != 0) {
+        fprintf(out, "# %zu samples dropped\n", dropped); // pprof skips comment lines
+    }
+
+    for (i = 0; i < n; i++) {
+        prof_record_t* rec = &records[i];
+        fprintf(out, "1: %zu [1: %zu] @", rec->size, rec->size);
+        for (j = 0; j < rec->depth; j++) {
+            fprintf(out, " %p", rec->stack[j]);
+        }
+        fprintf(out, "\n");
+    }
+
+    if (records != NULL) {
+        munmap(records, bytes);
+    }
+
+    fprintf(out, "\nMAPPED_LIBRARIES:\n");
+
+    FILE* maps = fopen("/proc/self/maps", "r");
+    if (maps != NULL) {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), maps)) > 0) {
+            fwrite(buf, 1, n, out);
+        }
+        fclose(maps);
+    }
+
+    fflush(out);
+    return ferror(out) ? false : true;
+}
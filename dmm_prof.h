@@ -0,0 +1,41 @@
+#ifndef __DMM_PROF_H__
+#define __DMM_PROF_H__
+
+#include "dmm.h"
+
+/*
+    Internal interface between dmm.c and the sampling heap profiler.
+
+    dmm_prof_countdown holds the number of bytes the calling thread has left
+    until its next sample. dmalloc subtracts every request from it and only
+    calls into the profiler once it drops below zero, so an unsampled
+    allocation costs one decrement.
+*/
+
+/*
+    Every allocator function that can stand between the program and
+    dmm_prof_sample goes into the dmm_frames section. A sample's backtrace
+    skips the frames in there, however they were inlined or recursed, so the
+    recorded stack starts at the program's own call.
+*/
+#define DMM_PROF_FRAME __attribute__((section("dmm_frames")))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern __thread long long dmm_prof_countdown __attribute__((tls_model("initial-exec")));
+
+void dmm_prof_init();
+bool dmm_prof_sample(void* ptr, size_t numbytes); // true if ptr was recorded
+void dmm_prof_forget(void* ptr);
+
+void dmm_prof_prefork(); // called by the heap's fork handlers
+void dmm_prof_postfork_parent();
+void dmm_prof_postfork_child();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of __DMM_PROF_H__ */
@@ -0,0 +1,260 @@
+#include <stdio.h> //needed for size_t
+#include <pthread.h> //for the heap lock
+#include <sys/mman.h> //for the mmap'ed region
+#include "dmm.h"
+#include "dmm_backend.h"
+
+/*
+    The "redo" backend, DMALLOC_BACKEND=redo: the allocator that used to live
+    in redo/ with its own Makefile and copies of the tests.
+
+    It keeps a single free list sorted by address and no footers. dfree walks
+    the list to find the freed block's place, which also finds the neighbours
+    to coalesce with, so freeing is O(free blocks) but every block carries
+    one header only. One lock covers the whole heap.
+*/
+
+typedef struct metadata {
+    size_t size; // the lowest bit is set while the block is in use
+    struct metadata* next;
+    struct metadata* prev;
+} metadata_t;
+
+/*
+ Blocks have no footer, so for every payload to stay DMALLOC_ALIGNMENT
+ aligned a whole block, header included, is rounded to it, and the region
+ starts REGION_PAD bytes in to align the first payload.
+ */
+#define BLOCK_ALIGN(size) (((size) + (DMALLOC_ALIGNMENT-1)) & ~(DMALLOC_ALIGNMENT-1))
+#define REGION_PAD ((DMALLOC_ALIGNMENT - METADATA_T_ALIGNED % DMALLOC_ALIGNMENT) % DMALLOC_ALIGNMENT)
+
+#define USE(ptr) (ptr->size += 1)
+#define UNUSE(ptr) ( ptr->size = (ptr->size - (ptr->size%8)) )
+
+/* freelist maintains all the blocks which are not in use; freelist is kept
+ * always sorted to improve the efficiency of coalescing
+ */
+
+static metadata_t* freelist = NULL;
+static metadata_t* head = NULL;
+static size_t max_bytes = 0;
+
+static pthread_mutex_t redo_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t redo_once = PTHREAD_ONCE_INIT;
+
+static void coalesce_with_back(metadata_t* my, metadata_t* back) {
+    
+    my->size += METADATA_T_ALIGNED + back->size;
+    
+    my->next = back->next;
+    
+    if (back->next != NULL) {
+        back->next->prev = my;
+    }
+    
+    back->next = NULL;
+    back->prev = NULL;
+}
+
+static void coalesce_with_front(metadata_t* front, metadata_t* my) {
+    
+    front->size += METADATA_T_ALIGNED + my->size;
+    
+    front->next = my->next;
+    
+    if (my->next != NULL) {
+        my->next->prev = front;
+    }
+    
+    my->next = NULL;
+    my->prev = NULL;
+}
+
+static void redo_prefork() {
+    pthread_mutex_lock(&redo_lock);
+}
+
+static void redo_postfork_parent() {
+    pthread_mutex_unlock(&redo_lock);
+}
+
+static void redo_postfork_child() {
+    pthread_mutex_init(&redo_lock, NULL);
+}
+
+static void redo_setup() {
+    pthread_atfork(redo_prefork, redo_postfork_parent, redo_postfork_child);
+}
+
+/* with the lock held */
+static bool heap_init() {
+    
+    size_t bytes = ALIGN(MAX_HEAP_SIZE);
+    
+    //mmap rather than sbrk, which would fight with malloc over the break
+    
+    void* region = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    
+    if (region == MAP_FAILED)
+        return false;
+    
+    freelist = (metadata_t*) (region + REGION_PAD);
+    max_bytes = bytes;
+    freelist->next = NULL;
+    freelist->prev = NULL;
+    freelist->size = ((max_bytes - REGION_PAD) & ~(DMALLOC_ALIGNMENT - 1)) - METADATA_T_ALIGNED;
+    
+    __atomic_store_n(&head, (metadata_t*) region, __ATOMIC_RELEASE); //redo_alloc checks it without the lock
+    return true;
+}
+
+static bool redo_init() {
+    
+    bool ok = true;
+    
+    pthread_once(&redo_once, redo_setup);
+    
+    pthread_mutex_lock(&redo_lock);
+    
+    if (head == NULL) {
+        ok = heap_init();
+    }
+    
+    pthread_mutex_unlock(&redo_lock);
+    
+    return ok;
+}
+
+static void* redo_alloc(size_t numbytes) {
+    
+    if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == NULL && !redo_init()) {
+        return NULL;
+    }
+    
+    if (numbytes > max_bytes) {
+        return NULL; //can never fit, and ALIGN would overflow near SIZE_MAX
+    }
+    
+    size_t numbytes_aligned = BLOCK_ALIGN(numbytes + METADATA_T_ALIGNED) - METADATA_T_ALIGNED;
+    
+    size_t requiredSpace = numbytes_aligned + METADATA_T_ALIGNED;
+    
+    pthread_mutex_lock(&redo_lock);
+    
+    //first-fit; the list is sorted, so this is the lowest block that fits
+    
+    metadata_t* cur_freelist_ptr = freelist;
+    
+    while (cur_freelist_ptr->size < requiredSpace) {
+        if (cur_freelist_ptr->next == NULL) {
+            pthread_mutex_unlock(&redo_lock);
+            return NULL;
+        }
+        cur_freelist_ptr = cur_freelist_ptr->next;
+    }
+    
+    //SPLIT: the remainder takes the block's place in the list
+    
+    metadata_t* new_freelist_ptr = (metadata_t*) (((void*)cur_freelist_ptr) + METADATA_T_ALIGNED + numbytes_aligned);
+    
+    new_freelist_ptr->prev = cur_freelist_ptr->prev;
+    new_freelist_ptr->next = cur_freelist_ptr->next;
+    
+    if (cur_freelist_ptr->prev != NULL) {
+        cur_freelist_ptr->prev->next = new_freelist_ptr;
+    } else {
+        freelist = new_freelist_ptr;
+    }
+    
+    if (cur_freelist_ptr->next != NULL) {
+        cur_freelist_ptr->next->prev = new_freelist_ptr;
+    }
+    
+    new_freelist_ptr->size = cur_freelist_ptr->size - numbytes_aligned - METADATA_T_ALIGNED;
+    
+    cur_freelist_ptr->size = numbytes_aligned;
+    
+    USE(cur_freelist_ptr);
+    
+    cur_freelist_ptr->next = NULL;
+    cur_freelist_ptr->prev = NULL;
+    
+    pthread_mutex_unlock(&redo_lock);
+    
+    return (((void*)cur_freelist_ptr) + METADATA_T_ALIGNED);
+}
+
+static void redo_free(void* ptr) {
+    
+    metadata_t* to_free_ptr = (metadata_t*) (((void*)ptr) - METADATA_T_ALIGNED);
+    
+    //the same checks dheap_free makes; redo_owns only told dfree which backend to ask
+    
+    if (((size_t) ptr & (DMALLOC_ALIGNMENT - 1)) != 0 || (void*) to_free_ptr < ((void*) head) + REGION_PAD) {
+        dmm_heap_abort("dfree of a pointer the heap does not own", ptr);
+    }
+    
+    pthread_mutex_lock(&redo_lock);
+    
+    if ((to_free_ptr->size & 0x1) == 0) {
+        pthread_mutex_unlock(&redo_lock);
+        dmm_heap_abort("double free", ptr);
+    }
+    
+    UNUSE(to_free_ptr);
+    
+    metadata_t* freelist_prev = NULL;
+    metadata_t* freelist_curr = freelist;
+    
+    //find the freed block's place between freelist_prev and freelist_curr
+    
+    while (freelist_curr != NULL && freelist_curr < to_free_ptr) {
+        freelist_prev = freelist_curr;
+        freelist_curr = freelist_curr->next;
+    }
+    
+    to_free_ptr->prev = freelist_prev;
+    to_free_ptr->next = freelist_curr;
+    
+    if (freelist_curr != NULL) {
+        freelist_curr->prev = to_free_ptr;
+    }
+    
+    if (freelist_prev != NULL) {
+        freelist_prev->next = to_free_ptr;
+    } else {
+        freelist = to_free_ptr;
+    }
+    
+    //the list neighbours are the only free blocks that can touch it
+    
+    if (freelist_curr == (metadata_t*) (((void*)to_free_ptr) + METADATA_T_ALIGNED + to_free_ptr->size)) {
+        coalesce_with_back(to_free_ptr, freelist_curr);
+    }
+    
+    if (freelist_prev != NULL && (metadata_t*) (((void*)freelist_prev) + METADATA_T_ALIGNED + freelist_prev->size) == to_free_ptr) {
+        coalesce_with_front(freelist_prev, to_free_ptr);
+    }
+    
+    pthread_mutex_unlock(&redo_lock);
+}
+
+static bool redo_owns(void* ptr) {
+    return (head != NULL && ptr > (void*) head && ptr < ((void*) head) + max_bytes) ? true : false;
+}
+
+static size_t redo_usable_size(void* ptr) {
+    
+    metadata_t* block = (metadata_t*) (ptr - METADATA_T_ALIGNED);
+    
+    return block->size & (~0x7);
+}
+
+const dmm_backend_t dmm_redo_backend = {
+    .name = "redo",
+    .init = redo_init,
+    .alloc = redo_alloc,
+    .free = redo_free,
+    .owns = redo_owns,
+    .usable_size = redo_usable_size,
+};
@@ -0,0 +1,476 @@
+#define _GNU_SOURCE //for memfd_create
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h> //for sysconf and ftruncate
+#include <errno.h>
+#include <fcntl.h> //for the shm_open flags
+#include <pthread.h> //for the process-shared lock
+#include <sys/mman.h> //for shm_open, memfd_create and mmap
+#include <sys/stat.h> //for fstat
+#include "dmm.h"
+#include "dmm_backend.h" //for dmm_heap_abort
+
+/*
+    Shared heaps. A shared heap lives entirely inside one MAP_SHARED mapping
+    of a POSIX shared memory object (dshm_create with a name, dshm_open in
+    the other processes) or of an anonymous memfd (no name, shared with the
+    children forked after dshm_create). Cooperating processes allocate and
+    free in it with dshm_alloc and dshm_free and hand blocks to each other
+    without copying.
+
+    Every process may map the segment at a different address, so nothing
+    inside it is a pointer. The segment starts with a shared_segment_t, and
+    blocks use the same boundary tags as dmm.c, except that the free list
+    links are offsets from the start of the segment; offset 0 is the segment
+    header and doubles as NULL. As in dmm.c, payloads are DMALLOC_ALIGNMENT
+    aligned: the first block starts HEAD_OFFSET bytes in, padded after the
+    segment header so that its payload is, and every payload size is rounded
+    to DMALLOC_ALIGNMENT. Blocks are exchanged between processes as
+    offsets too, see dshm_offset and dshm_pointer.
+
+    All state is protected by one robust, process-shared mutex in the
+    segment header. The free list is a single LIFO list searched first-fit.
+
+    Persistent heaps. dshm_open_file maps a regular file instead, so the
+    heap and everything in it outlive the process. A root offset in the
+    segment header leads a restarted process back to its data. The free
+    list is only a cache: the block sizes in the headers are the truth, and
+    every header write below leaves the chain of headers walkable. Opening a
+    file therefore rebuilds the free list by walking the headers, and so
+    does the next locker after a process died holding the lock. At worst a
+    block being allocated or freed at the time of the crash is leaked.
+*/
+
+#define SHARED_MAGIC 0x646d6d7368617265UL /* "dmmshare" */
+
+typedef struct shared_segment {
+    unsigned long magic;
+    size_t size; // bytes mapped, the segment header included
+    pthread_mutex_t lock;
+    size_t freelist; // offset of the first free block, 0 when there is none
+    size_t head; // offset of the first block
+    size_t root; // offset of the application's root object, 0 when unset
+} shared_segment_t;
+
+typedef struct shared_block {
+    size_t size; // payload bytes, with the used bit as in metadata_t
+    size_t next; // free list links, as offsets
+    size_t prev;
+} shared_block_t;
+
+struct dshm {
+    shared_segment_t segment; // a dshm_t is this process's view of the segment
+};
+
+#define SEGMENT_T_ALIGNED (ALIGN(sizeof(shared_segment_t)))
+#define BLOCK_T_ALIGNED (ALIGN(sizeof(shared_block_t)))
+#define FOOTER_ALIGNED SIZE_T_ALIGNED
+#define HEAD_OFFSET (PAYLOAD_ALIGN(SEGMENT_T_ALIGNED + BLOCK_T_ALIGNED) - BLOCK_T_ALIGNED)
+
+_Static_assert((BLOCK_T_ALIGNED + FOOTER_ALIGNED) % DMALLOC_ALIGNMENT == 0, "header and footer must keep payloads aligned");
+
+#define AT(h, off) ((void*) (((char*) (h)) + (off)))
+#define OFFSET(h, ptr) ((size_t) (((char*) (ptr)) - ((char*) (h))))
+#define BLOCK(h, off) ((shared_block_t*) AT(h, off))
+#define FOOTER(block) ((size_t*) (((char*) (block)) + BLOCK_T_ALIGNED + ((block)->size & (~0x7))))
+
+static void shared_recover(dshm_t* h);
+
+static void shared_lock(dshm_t* h) {
+
+    //a process died holding the lock, maybe halfway through the free list
+
+    if (pthread_mutex_lock(&h->segment.lock) == EOWNERDEAD) {
+        shared_recover(h);
+        pthread_mutex_consistent(&h->segment.lock);
+    }
+}
+
+static void shared_unlock(dshm_t* h) {
+    pthread_mutex_unlock(&h->segment.lock);
+}
+
+static void shared_insert(dshm_t* h, shared_block_t* block) {
+
+    size_t off = OFFSET(h, block);
+
+    block->prev = 0;
+    block->next = h->segment.freelist;
+
+    if (block->next != 0) {
+        BLOCK(h, block->next)->prev = off;
+    }
+
+    h->segment.freelist = off;
+}
+
+static void shared_remove(dshm_t* h, shared_block_t* block) {
+
+    if (block->prev != 0) {
+        BLOCK(h, block->prev)->next = block->next;
+    } else {
+        h->segment.freelist = block->next;
+    }
+
+    if (block->next != 0) {
+        BLOCK(h, block->next)->prev = block->prev;
+    }
+
+    block->next = 0;
+    block->prev = 0;
+}
+
+/*
+    Rebuilds the free list from the headers, merging runs of free blocks and
+    rewriting every footer. A header whose size runs past the end of the
+    segment cannot be trusted, nor anything after it; that tail becomes one
+    free block.
+*/
+static void shared_recover(dshm_t* h) {
+
+    shared_block_t* last_free = NULL;
+    size_t off = h->segment.head;
+
+    h->segment.freelist = 0;
+
+    while (off < h->segment.size) {
+
+        shared_block_t* block = BLOCK(h, off);
+
+        if (h->segment.size - off < BLOCK_T_ALIGNED + FOOTER_ALIGNED) {
+            break; // cannot happen unless the head offset itself is garbage
+        }
+
+        size_t limit = (h->segment.size - off - BLOCK_T_ALIGNED - FOOTER_ALIGNED) & ~(DMALLOC_ALIGNMENT - 1);
+
+        if ((block->size & (~0x7)) > limit || (block->size & (DMALLOC_ALIGNMENT - 1) & (~0x1)) != 0) {
+            block->size = limit;
+        }
+
+        *FOOTER(block) = block->size;
+
+        if (block->size % 8 != 0) {
+            last_free = NULL;
+        } else if (last_free != NULL) {
+            last_free->size += FOOTER_ALIGNED + BLOCK_T_ALIGNED + block->size;
+            *FOOTER(last_free) = last_free->size;
+        } else {
+            shared_insert(h, block);
+            last_free = block;
+        }
+
+        off += BLOCK_T_ALIGNED + (block->size & (~0x7)) + FOOTER_ALIGNED;
+    }
+}
+
+static bool shared_init_lock(dshm_t* h) {
+
+    pthread_mutexattr_t attr;
+
+    if (pthread_mutexattr_init(&attr) != 0) {
+        return false;
+    }
+
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+
+    int err = pthread_mutex_init(&h->segment.lock, &attr);
+
+    pthread_mutexattr_destroy(&attr);
+
+    return (err == 0) ? true : false;
+}
+
+/* formats a fresh mapping as an empty heap */
+static bool shared_format(dshm_t* h, size_t size) {
+
+    if (!shared_init_lock(h)) {
+        return false;
+    }
+
+    h->segment.size = size;
+    h->segment.head = HEAD_OFFSET;
+    h->segment.freelist = 0;
+    h->segment.root = 0;
+
+    shared_block_t* first = BLOCK(h, h->segment.head);
+
+    first->size = (size - HEAD_OFFSET - BLOCK_T_ALIGNED - FOOTER_ALIGNED) & ~(DMALLOC_ALIGNMENT - 1);
+    *FOOTER(first) = first->size;
+
+    shared_insert(h, first);
+
+    //the magic goes in last, so dshm_open never sees a half-formatted heap
+
+    __atomic_store_n(&h->segment.magic, SHARED_MAGIC, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static dshm_t* shared_map(int fd, size_t size) {
+
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    return (base == MAP_FAILED) ? NULL : (dshm_t*) base;
+}
+
+dshm_t* dshm_create(const char* name, size_t size) {
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+    if (size > ((size_t) -1) / 2) {
+        return NULL;
+    }
+
+    size = (size + HEAD_OFFSET + BLOCK_T_ALIGNED + FOOTER_ALIGNED + page - 1) & ~(page - 1);
+
+    int fd = (name != NULL) ? shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600) : memfd_create("dmm_shared", MFD_CLOEXEC);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    dshm_t* h = NULL;
+
+    if (ftruncate(fd, (off_t) size) == 0) {
+        h = shared_map(fd, size);
+    }
+
+    close(fd); // the mapping keeps the object alive
+
+    if (h != NULL && !shared_format(h, size)) {
+        munmap(h, size);
+        h = NULL;
+    }
+
+    if (h == NULL && name != NULL) {
+        shm_unlink(name);
+    }
+
+    return h;
+}
+
+dshm_t* dshm_open(const char* name) {
+
+    struct stat st;
+    dshm_t* h = NULL;
+
+    int fd = shm_open(name, O_RDWR, 0);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= SEGMENT_T_ALIGNED) {
+        h = shared_map(fd, (size_t) st.st_size);
+    }
+
+    close(fd);
+
+    if (h != NULL && (__atomic_load_n(&h->segment.magic, __ATOMIC_ACQUIRE) != SHARED_MAGIC || h->segment.size != (size_t) st.st_size)) {
+        munmap(h, (size_t) st.st_size);
+        return NULL; // not a shared heap, or its creator is still formatting it
+    }
+
+    return h;
+}
+
+/*
+    Opens a persistent heap, creating the file with size bytes of heap if it
+    does not exist yet. An existing heap keeps its size, and its free list is
+    rebuilt from the headers, so the lock and the links left behind by a
+    crash do not matter; the caller must be the file's only user while it
+    opens it.
+*/
+dshm_t* dshm_open_file(const char* path, size_t size) {
+
+    struct stat st;
+    dshm_t* h = NULL;
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    bool fresh = ((size_t) st.st_size < SEGMENT_T_ALIGNED) ? true : false;
+
+    if (fresh) {
+        if (size > ((size_t) -1) / 2) {
+            close(fd);
+            return NULL;
+        }
+
+        size = (size + HEAD_OFFSET + BLOCK_T_ALIGNED + FOOTER_ALIGNED + page - 1) & ~(page - 1);
+
+        if (ftruncate(fd, (off_t) size) != 0) {
+            close(fd);
+            return NULL;
+        }
+    } else {
+        size = (size_t) st.st_size;
+    }
+
+    h = shared_map(fd, size);
+
+    close(fd);
+
+    if (h == NULL) {
+        return NULL;
+    }
+
+    if (fresh ? !shared_format(h, size)
+              : (h->segment.magic != SHARED_MAGIC || h->segment.size != size || h->segment.head != HEAD_OFFSET
+                 || !shared_init_lock(h))) {
+        munmap(h, size);
+        return NULL; // not a heap file, or one of another layout
+    }
+
+    if (!fresh) {
+        shared_recover(h);
+    }
+
+    return h;
+}
+
+void* dshm_root(dshm_t* h) {
+    return dshm_pointer(h, __atomic_load_n(&h->segment.root, __ATOMIC_ACQUIRE));
+}
+
+void dshm_set_root(dshm_t* h, void* ptr) {
+    __atomic_store_n(&h->segment.root, dshm_offset(h, ptr), __ATOMIC_RELEASE);
+}
+
+/* writes the heap back to its file, for persistence across machine crashes */
+bool dshm_sync(dshm_t* h) {
+    return (msync(h, h->segment.size, MS_SYNC) == 0) ? true : false;
+}
+
+void dshm_close(dshm_t* h) {
+    munmap(h, h->segment.size);
+}
+
+/* first-fit and split, as arena_alloc does it */
+void* dshm_alloc(dshm_t* h, size_t numbytes) {
+
+    if (numbytes == 0 || numbytes > h->segment.size) {
+        return NULL;
+    }
+
+    size_t numbytes_aligned = PAYLOAD_ALIGN(numbytes);
+    size_t requiredSpace = numbytes_aligned + FOOTER_ALIGNED + BLOCK_T_ALIGNED;
+
+    shared_lock(h);
+
+    size_t off = h->segment.freelist;
+
+    while (off != 0 && BLOCK(h, off)->size < requiredSpace) {
+        off = BLOCK(h, off)->next;
+    }
+
+    if (off == 0) {
+        shared_unlock(h);
+        return NULL;
+    }
+
+    shared_block_t* block = BLOCK(h, off);
+
+    //the remainder keeps the block's place in the list
+
+    shared_block_t* rest = (shared_block_t*) (((char*) block) + BLOCK_T_ALIGNED + numbytes_aligned + FOOTER_ALIGNED);
+
+    rest->size = block->size - numbytes_aligned - FOOTER_ALIGNED - BLOCK_T_ALIGNED;
+    *FOOTER(rest) = rest->size;
+    rest->prev = block->prev;
+    rest->next = block->next;
+
+    if (rest->prev != 0) {
+        BLOCK(h, rest->prev)->next = OFFSET(h, rest);
+    } else {
+        h->segment.freelist = OFFSET(h, rest);
+    }
+
+    if (rest->next != 0) {
+        BLOCK(h, rest->next)->prev = OFFSET(h, rest);
+    }
+
+    //the remainder's header must be in place before the block's header points at it
+
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+    block->size = numbytes_aligned | 0x1;
+    *FOOTER(block) = block->size;
+
+    shared_unlock(h);
+
+    return ((void*) block) + BLOCK_T_ALIGNED;
+}
+
+/* frees and merges with both neighbours, as free_block and coalesce do it */
+void dshm_free(dshm_t* h, void* ptr) {
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    shared_block_t* block = (shared_block_t*) (ptr - BLOCK_T_ALIGNED);
+
+    //the checks dheap_free makes, against this segment
+
+    if (((size_t) ptr & (DMALLOC_ALIGNMENT - 1)) != 0 || OFFSET(h, block) < h->segment.head
+        || OFFSET(h, ptr) >= h->segment.size) {
+        dmm_heap_abort("dshm_free of a pointer the heap does not own", ptr);
+    }
+
+    shared_lock(h);
+
+    if ((block->size & 0x1) == 0) {
+        shared_unlock(h);
+        dmm_heap_abort("double free", ptr);
+    }
+
+    block->size &= ~0x7;
+    *FOOTER(block) = block->size;
+
+    shared_block_t* next = (shared_block_t*) (((char*) FOOTER(block)) + FOOTER_ALIGNED);
+
+    //the bytes left over at the end of the segment are too few for a block
+
+    if (h->segment.size - OFFSET(h, next) >= BLOCK_T_ALIGNED + FOOTER_ALIGNED && next->size % 8 == 0) {
+        shared_remove(h, next);
+        block->size += FOOTER_ALIGNED + BLOCK_T_ALIGNED + next->size;
+        *FOOTER(block) = block->size;
+    }
+
+    if (OFFSET(h, block) != h->segment.head) {
+
+        size_t* prev_footer = (size_t*) (((char*) block) - FOOTER_ALIGNED);
+
+        if (*prev_footer % 8 == 0) {
+            shared_block_t* prev = (shared_block_t*) (((char*) prev_footer) - *prev_footer - BLOCK_T_ALIGNED);
+
+            shared_remove(h, prev);
+            prev->size += FOOTER_ALIGNED + BLOCK_T_ALIGNED + block->size;
+            *FOOTER(prev) = prev->size;
+            block = prev;
+        }
+    }
+
+    shared_insert(h, block);
+
+    shared_unlock(h);
+}
+
+size_t dshm_offset(dshm_t* h, void* ptr) {
+    return (ptr == NULL) ? 0 : OFFSET(h, ptr);
+}
+
+void* dshm_pointer(dshm_t* h, size_t offset) {
+    return (offset == 0) ? NULL : AT(h, offset);
+}
@@ -0,0 +1,43 @@
+#ifndef __DMM_TRACE_H__
+#define __DMM_TRACE_H__
+
+/*
+    Static tracepoints (USDT probes) for the heap manager, provider "dmm".
+
+    With systemtap's <sys/sdt.h> available every probe is a single NOP plus an
+    ELF note describing where its arguments live, so an untraced process pays
+    nothing. Without the header, or with -DDMM_NO_USDT, the probes compile to
+    nothing at all.
+
+    Probes and arguments:
+        dmm:malloc       (ptr, numbytes)              dmalloc, dheap_alloc, dmemalign or a size class returned ptr
+        dmm:fit          (ptr, numbytes, search_len)  an arena's free lists served the request
+        dmm:malloc_fail  (numbytes, search_len)       no free block was big enough
+        dmm:split        (ptr, size, remainder)       a free block was split
+        dmm:free         (ptr, size)                  dfree or dheap_free accepted ptr
+        dmm:coalesce     (ptr, size, with)            merged; with is 0 for the next block, 1 for the previous
+        dmm:heap_grow    (base, bytes)                heap region obtained from the OS
+
+    dmm:malloc and dmm:free fire once per call whichever path serves it, the
+    CPU caches, the class lists, the quarantine and deferred frees included;
+    the redo backend has no probes.
+    search_len is the number of free blocks the arena inspected. For example:
+        bpftrace -e 'usdt:./test_stress2:dmm:fit { @walk = hist(arg2); }'
+*/
+
+#if !defined(DMM_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DMM_HAVE_USDT
+#endif
+#endif
+
+#ifdef DMM_HAVE_USDT
+	#define DMM_TRACE2(name, a1, a2) DTRACE_PROBE2(dmm, name, a1, a2)
+	#define DMM_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(dmm, name, a1, a2, a3)
+#else
+	#define DMM_TRACE2(name, a1, a2)
+	#define DMM_TRACE3(name, a1, a2, a3)
+#endif
+
+#endif /* end of __DMM_TRACE_H__ */
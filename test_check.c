@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit and setenv
+#include <string.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NPTRS 1000
+
+/*
+ * DMALLOC_CHECK=1: ordinary use passes the checks, and a block whose
+ * header or footer was overwritten makes dfree abort instead of being
+ * coalesced.
+ */
+
+static void overflow_into_next(void)
+{
+	char *a = dmalloc(64);
+	char *b = dmalloc(64);
+
+	memset(a, 'x', 64 + 16); /* a's footer and b's size */
+	dfree(b);
+}
+
+static void overflow_into_footer(void)
+{
+	char *a = dmalloc(64);
+
+	dmalloc(64);
+	memset(a, 'x', 64 + 8);
+	dfree(a);
+}
+
+static void underflow_into_prev(void)
+{
+	char *a = dmalloc(64);
+	char *b = dmalloc(64);
+	char *c = dmalloc(64);
+
+	dfree(a);
+	memset(b - 32, 'x', 8); /* a's footer, a being free now */
+	dfree(c);
+	dfree(b);
+}
+
+int main(int argc, char *argv[])
+{
+	void *ptr[NPTRS];
+	int i, j;
+
+	setenv("DMALLOC_CHECK", "1", 1);
+
+	for(j = 0; j < 20; j++)
+	{
+		for(i = 0; i < NPTRS; i++)
+		{
+			ptr[i] = (i % 10 == 0) ? dmemalign(64, 1 + i) : dmalloc(1 + (i * 37 + j) % 3000);
+			if(ptr[i] == NULL)
+				fail("call to dmalloc() failed");
+		}
+		for(i = 0; i < NPTRS; i++)
+			dfree(ptr[(i * 7 + j) % NPTRS]);
+	}
+
+	expect_abort(overflow_into_next, "an overwritten header went unnoticed");
+	expect_abort(overflow_into_footer, "an overwritten footer went unnoticed");
+	expect_abort(underflow_into_prev, "overwritten boundary tags of a free block went unnoticed");
+
+	printf("Integrity check testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <string.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+/*
+ * The heap is only reserved at init; pages get committed as allocations
+ * reach them, and every byte handed out must be writable. With huge pages
+ * the first commit is a whole huge page.
+ */
+
+int main(int argc, char *argv[])
+{
+	char *ptr[1000];
+	size_t before;
+	int i, n;
+
+	if(!dmalloc_init())
+		fail("call to dmalloc_init() failed");
+
+	before = dmalloc_committed();
+	printf("committed after init: %zu of %d bytes\n", before, MAX_HEAP_SIZE);
+	if(before == 0 || (getenv("DMALLOC_HUGEPAGES") == NULL && before > MAX_HEAP_SIZE / 4))
+		fail("init committed too much of the heap");
+
+	ptr[0] = dmalloc(MAX_HEAP_SIZE / 2);
+	if(ptr[0] == NULL || dmalloc_committed() < MAX_HEAP_SIZE / 2)
+		fail("a large block was not committed");
+	memset(ptr[0], 'x', MAX_HEAP_SIZE / 2);
+	dfree(ptr[0]);
+
+	/*
+	 * fill the whole heap, touching every block
+	 */
+	for(n = 0; n < 1000; n++)
+	{
+		ptr[n] = dmalloc(MAX_HEAP_SIZE / 1000);
+		if(ptr[n] == NULL)
+			break;
+		memset(ptr[n], n, MAX_HEAP_SIZE / 1000);
+	}
+	if(n < 900)
+		fail("the heap could not be filled");
+	printf("committed after filling: %zu bytes\n", dmalloc_committed());
+
+	for(i = 0; i < n; i++)
+		dfree(ptr[i]);
+
+	printf("Lazy commit testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <vector>
+#include <map>
+#include <string>
+#include <memory_resource>
+
+#include "dmm.hpp"
+#include "test_util.h"
+
+/*
+ * Standard containers over dmm::allocator and dmm::memory_resource, and
+ * plain new/delete through the replacement operators in dmm_new.o.
+ */
+
+struct alignas(64) line {
+	char bytes[64];
+};
+
+int main(int argc, char *argv[])
+{
+	std::vector<int, dmm::allocator<int> > v;
+	std::map<int, int, std::less<int>, dmm::allocator<std::pair<const int, int> > > m;
+	int i;
+
+	for(i = 0; i < 10000; i++)
+	{
+		v.push_back(i);
+		m[i % 100] += i;
+	}
+	if(!dmalloc_owns(v.data()) || v[9999] != 9999 || m[99] != 504900)
+		fail("containers over dmm::allocator misbehave");
+
+	std::pmr::vector<std::pmr::string> words(dmm::heap_resource());
+	for(i = 0; i < 100; i++)
+		words.emplace_back("a string too long for the small string buffer");
+	if(!dmalloc_owns(words.data()) || !dmalloc_owns(words[50].data()))
+		fail("pmr containers were not served by the heap");
+
+	int *n = new int(42);
+	int *arr = new int[1000];
+	line *l = new line;
+	if(!dmalloc_owns(n) || !dmalloc_owns(arr) || !dmalloc_owns(l))
+		fail("operator new was not replaced");
+	if(((size_t)l & 63) != 0)
+		fail("aligned operator new returned a misaligned block");
+	delete n;
+	delete[] arr;
+	delete l;
+
+	for(i = 0; i < 100; i++)
+	{
+		long double *ld = new long double[1 + i % 7];
+		line *lines = new line[1 + i % 3];
+		if(((size_t)ld & (__STDCPP_DEFAULT_NEW_ALIGNMENT__ - 1)) != 0 || ((size_t)lines & (alignof(line) - 1)) != 0)
+			fail("operator new[] returned a misaligned block");
+		delete[] ld;
+		delete[] lines;
+	}
+
+	void *small = dmm::dmalloc<sizeof(line)>();
+	void *large = dmm::dmalloc<1000>();
+	if(!dmalloc_owns(small) || dmalloc_usable_size(small) < sizeof(line) || dmalloc_usable_size(large) < 1000)
+		fail("dmm::dmalloc<N>() returned a short block");
+	dfree(small);
+	dfree(large);
+
+	try
+	{
+		std::vector<char, dmm::allocator<char> > huge(2 * MAX_HEAP_SIZE);
+		fail("allocation larger than the heap succeeded");
+	}
+	catch(const std::bad_alloc&)
+	{
+	}
+
+	printf("C++ testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit, getenv and setenv
+#include <unistd.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NPTRS 1000
+
+/*
+ * DMALLOC_DEFER: dfree leaves the coalescing to later, and the heap still
+ * comes back in one piece. With DMALLOC_DEFER_INTERVAL set, the maintenance
+ * thread must have done it by itself.
+ */
+
+static void count_free(void *ptr, size_t size, bool used, void *arg)
+{
+	if(!used)
+		(*(int *)arg)++;
+}
+
+int main(int argc, char *argv[])
+{
+	void *ptr[NPTRS];
+	size_t merged;
+	int i, nfree;
+
+	setenv("DMALLOC_DEFER", "1", 1);
+
+	for(i = 0; i < NPTRS; i++)
+	{
+		ptr[i] = dmalloc(100 + i % 7 * 50);
+		if(ptr[i] == NULL)
+			fail("call to dmalloc() failed");
+	}
+	for(i = 0; i < NPTRS; i += 2)
+		dfree(ptr[i]);
+
+	/*
+	 * the maintenance thread, when there is one, gets the first batch
+	 */
+	if(getenv("DMALLOC_DEFER_INTERVAL") != NULL)
+		usleep(200 * 1000);
+	merged = dmalloc_coalesce();
+	printf("%zu blocks coalesced on request\n", merged);
+	if(getenv("DMALLOC_DEFER_INTERVAL") != NULL ? merged != 0 : merged != NPTRS / 2)
+		fail("expected the freed blocks to be coalesced later");
+
+	for(i = 1; i < NPTRS; i += 2)
+		dfree(ptr[i]);
+
+	/*
+	 * a dmalloc that finds no fit coalesces the rest itself
+	 */
+	ptr[0] = dmalloc(MAX_HEAP_SIZE / 2);
+	if(ptr[0] == NULL)
+		fail("heap did not coalesce back");
+	dfree(ptr[0]);
+
+	nfree = 0;
+	dmalloc_walk(count_free, &nfree);
+	if(nfree != 1)
+		fail("expected a single free block after the walk");
+
+	/*
+	 * with the thread stopped, coalescing is left to the slow path and
+	 * dmalloc_coalesce again
+	 */
+	dmalloc_maintenance_stop();
+	dmalloc_maintenance_stop();
+	ptr[0] = dmalloc(100);
+	ptr[1] = dmalloc(100);
+	dfree(ptr[0]);
+	usleep(50 * 1000);
+	if(dmalloc_coalesce() != 1)
+		fail("a deferred free was coalesced after the thread stopped");
+	dfree(ptr[1]);
+	dmalloc_coalesce();
+
+	printf("Deferred coalescing testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <string.h>
+#include <pthread.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+/*
+ * Double and invalid frees abort with a diagnostic instead of corrupting
+ * the free lists. Also run with DMALLOC_PERCPU=1 and DMALLOC_CLASS_LOCKS=1,
+ * where the first free only parks small blocks.
+ */
+
+static void double_free_large(void)
+{
+	char *a = dmalloc(5000);
+	char *b = dmalloc(5000);
+
+	dfree(a);
+	dfree(b); /* a is coalesced with its neighbours by now */
+	dfree(a);
+}
+
+static void double_free_small(void)
+{
+	char *a = dmalloc(32);
+
+	dfree(a);
+	dfree(a);
+}
+
+static void *free_elsewhere(void *ptr)
+{
+	dfree(ptr);
+	return NULL;
+}
+
+static void double_free_remote(void)
+{
+	pthread_t thread;
+	char *a = dmalloc(1000);
+
+	pthread_create(&thread, NULL, free_elsewhere, a);
+	pthread_join(thread, NULL);
+	dfree(a); /* still on the remote free stack */
+}
+
+static void free_stack_pointer(void)
+{
+	char buf[64];
+
+	dfree(buf + 32);
+}
+
+static void free_interior_pointer(void)
+{
+	char *a = dmalloc(100);
+
+	dfree(a + 4);
+}
+
+static void free_misaligned_pointer(void)
+{
+	char *a = dmalloc(100);
+
+	dfree(a + 8);
+}
+
+static void free_uncommitted_pointer(void)
+{
+	char *a = dmalloc(16);
+
+	dfree(a + 2 * 1024 * 1024); /* inside the region, beyond what was ever used */
+}
+
+static void free_foreign_pointer(void)
+{
+	dfree(malloc(100));
+}
+
+int main(int argc, char *argv[])
+{
+	char *a;
+
+	/* the first dmalloc makes this thread the arena's owner */
+	a = dmalloc(100);
+	dfree(a);
+	dfree(NULL);
+
+	expect_abort(double_free_large, "a double free of a coalesced block went unnoticed");
+	expect_abort(double_free_small, "a double free of a small block went unnoticed");
+	expect_abort(double_free_remote, "a double free after a remote free went unnoticed");
+	expect_abort(free_stack_pointer, "dfree accepted a stack pointer");
+	expect_abort(free_interior_pointer, "dfree accepted a pointer into a block");
+	expect_abort(free_misaligned_pointer, "dfree accepted a pointer 8 bytes into a block");
+	expect_abort(free_uncommitted_pointer, "dfree accepted a pointer into the unused region");
+	expect_abort(free_foreign_pointer, "dfree accepted a pointer from another allocator");
+
+	/*
+	 * the checks must not get in the way of correct use
+	 */
+	a = dmalloc(MAX_HEAP_SIZE / 2);
+	if(a == NULL)
+		fail("the heap was not left intact");
+	dfree(a);
+
+	printf("Invalid free testcases passed!\n");
+	return(0);
+}
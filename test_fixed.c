@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <string.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NPTRS 2000
+
+/*
+ * DMALLOC_FIXED with constant sizes: blocks are big enough, do not overlap
+ * and go back to the heap through dfree. Also run with DMALLOC_PERCPU=1 and
+ * DMALLOC_CLASS_LOCKS=1, where it pops the cached classes directly.
+ */
+
+struct node {
+	struct node *next;
+	long key;
+	char name[40];
+};
+
+int main(int argc, char *argv[])
+{
+	struct node *list = NULL, *n;
+	char *small[NPTRS], *big;
+	long i;
+
+	for(i = 0; i < NPTRS; i++)
+	{
+		n = DMALLOC_FIXED(sizeof(struct node));
+		if(n == NULL || dmalloc_usable_size(n) < sizeof(struct node))
+			fail("DMALLOC_FIXED returned a short block");
+		n->key = i;
+		snprintf(n->name, sizeof(n->name), "node %ld", i);
+		n->next = list;
+		list = n;
+
+		small[i] = DMALLOC_FIXED(1);
+		if(small[i] == NULL)
+			fail("DMALLOC_FIXED(1) failed");
+		small[i][0] = (char)i;
+	}
+
+	for(i = NPTRS - 1; i >= 0; i--)
+	{
+		char name[40];
+		snprintf(name, sizeof(name), "node %ld", i);
+		if(list->key != i || strcmp(list->name, name) != 0 || small[i][0] != (char)i)
+			fail("blocks from DMALLOC_FIXED overlap");
+		n = list->next;
+		dfree(list);
+		dfree(small[i]);
+		list = n;
+	}
+
+	/*
+	 * sizes above DMALLOC_SMALL_MAX take the general path
+	 */
+	big = DMALLOC_FIXED(DMALLOC_SMALL_MAX + 1);
+	if(big == NULL || dmalloc_usable_size(big) < DMALLOC_SMALL_MAX + 1)
+		fail("DMALLOC_FIXED of a large size failed");
+	dfree(big);
+
+	big = dmalloc(MAX_HEAP_SIZE / 2);
+	if(big == NULL)
+		fail("freed fixed-size blocks were not returned to the heap");
+	dfree(big);
+
+	printf("Fixed-size testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NFORKS 200
+
+/*
+ * fork() while another thread keeps allocating must leave the child with a
+ * usable heap, and a signal handler must be able to allocate from the
+ * emergency pool.
+ */
+
+static volatile int stop = 0;
+static char *from_handler = NULL;
+
+static void *churn(void *arg)
+{
+	while(!stop)
+	{
+		char *p = dmalloc(100);
+		if(p != NULL)
+			dfree(p);
+	}
+	return NULL;
+}
+
+static void handler(int sig)
+{
+	from_handler = dmalloc_emergency(64);
+	if(from_handler != NULL)
+		strcpy(from_handler, "in handler");
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t thread;
+	int i, status;
+	pid_t pid;
+	char *p;
+
+	p = dmalloc(16);
+	dfree(p);
+
+	if(pthread_create(&thread, NULL, churn, NULL) != 0)
+		fail("pthread_create failed");
+
+	for(i = 0; i < NFORKS; i++)
+	{
+		pid = fork();
+		if(pid == 0)
+		{
+			dmalloc_prof_set_rate(1); /* takes the profiler's lock too */
+			p = dmalloc(1000);
+			if(p == NULL)
+				_exit(1);
+			dfree(p);
+			_exit(0);
+		}
+		if(pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			fail("allocation in forked child %d failed", i);
+	}
+
+	stop = 1;
+	pthread_join(thread, NULL);
+
+	if(dmalloc_emergency(64) != NULL)
+		fail("dmalloc_emergency() succeeded without a pool");
+	if(!dmalloc_emergency_reserve(4096))
+		fail("dmalloc_emergency_reserve() failed");
+	signal(SIGUSR1, handler);
+	raise(SIGUSR1);
+	if(from_handler == NULL || strcmp(from_handler, "in handler") != 0)
+		fail("the signal handler could not allocate");
+
+	printf("Fork and signal testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <string.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define HEAP_SIZE (256*1024)
+
+/*
+ * Separate heaps: blocks stay in their own heap, exhausting one heap leaves
+ * the others alone, and a destroyed heap takes its blocks with it.
+ */
+
+int main(int argc, char *argv[])
+{
+	dheap_t *cache, *logging;
+	char *a, *b, *big;
+	int i, n;
+
+	cache = dheap_create(HEAP_SIZE);
+	logging = dheap_create(HEAP_SIZE);
+	if(cache == NULL || logging == NULL)
+		fail("call to dheap_create() failed");
+
+	a = dheap_alloc(cache, 100);
+	b = dheap_alloc(logging, 100);
+	if(a == NULL || b == NULL)
+		fail("call to dheap_alloc() failed");
+	if(dmalloc_owns(a) || dmalloc_owns(b) || (a < b ? b - a : a - b) < HEAP_SIZE)
+		fail("blocks of separate heaps are not apart");
+	strcpy(a, "cache");
+	strcpy(b, "logging");
+
+	/*
+	 * fill the cache heap up; the logging heap and the default heap must
+	 * not notice
+	 */
+	for(n = 0; dheap_alloc(cache, 1000) != NULL; n++)
+		;
+	if(n == 0 || n > HEAP_SIZE / 1000)
+		fail("the cache heap has the wrong size");
+	if(dheap_alloc(cache, 1000) != NULL)
+		fail("the cache heap was not exhausted");
+	big = dheap_alloc(logging, HEAP_SIZE / 2);
+	if(big == NULL || strcmp(b, "logging") != 0)
+		fail("exhausting one heap broke another");
+	dheap_free(logging, big);
+	big = dmalloc(MAX_HEAP_SIZE / 2);
+	if(big == NULL)
+		fail("exhausting a heap broke the default heap");
+	dfree(big);
+
+	/*
+	 * destroying frees everything at once, and heaps can be made again
+	 */
+	dheap_destroy(cache);
+	for(i = 0; i < 10; i++)
+	{
+		cache = dheap_create(HEAP_SIZE);
+		if(cache == NULL || dheap_alloc(cache, HEAP_SIZE / 2) == NULL)
+			fail("could not recreate the heap");
+		dheap_destroy(cache);
+	}
+
+	dheap_free(logging, b);
+	big = dheap_alloc(logging, HEAP_SIZE - 128);
+	if(big == NULL)
+		fail("freed blocks were not coalesced in their heap");
+	dheap_destroy(logging);
+
+	printf("Heap object testcases passed!\n");
+	return(0);
+}
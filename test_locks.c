@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit and setenv
+#include <string.h>
+#include <pthread.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NTHREADS 4
+#define NPTRS 200
+#define ROUNDS 200
+
+/*
+ * Size-class locks: threads working on different small classes keep their
+ * contents apart, the lock statistics see them, and every block cached on a
+ * class list can still be coalesced back into one large block.
+ */
+
+static void *worker(void *arg)
+{
+	long id = (long)arg;
+	char *ptr[NPTRS];
+	int i, j, r;
+
+	for(r = 0; r < ROUNDS; r++)
+	{
+		for(i = 0; i < NPTRS; i++)
+		{
+			/* each thread mostly stays in its own class, with a few large blocks mixed in */
+			size_t size = (i % 16 == 0) ? 1000 + id : 16 * (id + 1) - (i % 8);
+			ptr[i] = dmalloc(size);
+			if(ptr[i] == NULL)
+				fail("call to dmalloc() failed");
+			memset(ptr[i], 'a' + id, size);
+		}
+		for(i = 0; i < NPTRS; i++)
+		{
+			size_t size = (i % 16 == 0) ? 1000 + id : 16 * (id + 1) - (i % 8);
+			for(j = 0; j < (int)size; j++)
+			{
+				if(ptr[i][j] != 'a' + id)
+					fail("a block was handed to two threads");
+			}
+			dfree(ptr[i]);
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t threads[NTHREADS];
+	dmalloc_lock_stats_t arena_locks, class_locks;
+	char *big;
+	long i;
+
+	setenv("DMALLOC_CLASS_LOCKS", "1", 1);
+	setenv("DMALLOC_LOCK_STATS", "1", 1);
+
+	for(i = 0; i < NTHREADS; i++)
+	{
+		if(pthread_create(&threads[i], NULL, worker, (void *)i) != 0)
+			fail("pthread_create failed");
+	}
+	for(i = 0; i < NTHREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	dmalloc_lock_stats(&arena_locks, &class_locks);
+	printf("arena locks: %lu acquired, %lu contended; class locks: %lu acquired, %lu contended\n",
+	       arena_locks.acquired, arena_locks.contended, class_locks.acquired, class_locks.contended);
+	if(class_locks.acquired < NTHREADS * NPTRS || arena_locks.acquired == 0)
+		fail("the small classes did not go through the class locks");
+	if(class_locks.acquired < arena_locks.acquired)
+		fail("small blocks still mostly go through the arena lock");
+	if(arena_locks.hold_ns == 0)
+		fail("DMALLOC_LOCK_STATS=1 did not time the lock holds");
+
+	/*
+	 * blocks parked on the class lists must come back when the heap runs short
+	 */
+	big = dmalloc(MAX_HEAP_SIZE / 2);
+	if(big == NULL)
+		fail("blocks on the class lists were not returned to the heap");
+	dfree(big);
+
+	printf("Class lock testcases passed!\n");
+	return(0);
+}
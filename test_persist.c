@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define HEAP_SIZE (1024*1024)
+#define NNODES 1000
+
+/*
+ * Persistent heaps: a list built in a heap file is found again through the
+ * root after reopening, also when the process that used it was killed in
+ * the middle of allocating and freeing.
+ */
+
+typedef struct node {
+	size_t next; /* offset of the next node, 0 ends the list */
+	long key;
+} node_t;
+
+static void check_list(dshm_t *heap)
+{
+	node_t *n = dshm_root(heap);
+	long i;
+
+	for(i = NNODES - 1; i >= 0; i--)
+	{
+		if(n == NULL || n->key != i)
+			fail("the list in the heap file was lost");
+		n = dshm_pointer(heap, n->next);
+	}
+	if(n != NULL)
+		fail("the list in the heap file grew");
+}
+
+int main(int argc, char *argv[])
+{
+	char path[64];
+	dshm_t *heap;
+	node_t *n, *head = NULL;
+	void *junk[64];
+	int status, i;
+	pid_t pid;
+
+	snprintf(path, sizeof(path), "/tmp/dmm_test_persist.%d", (int)getpid());
+	unlink(path);
+
+	heap = dshm_open_file(path, HEAP_SIZE);
+	if(heap == NULL)
+		fail("call to dshm_open_file() failed");
+	for(i = 0; i < NNODES; i++)
+	{
+		n = dshm_alloc(heap, sizeof(node_t));
+		if(n == NULL)
+			fail("call to dshm_alloc() failed");
+		n->key = i;
+		n->next = dshm_offset(heap, head);
+		head = n;
+	}
+	dshm_set_root(heap, head);
+	if(!dshm_sync(heap))
+		fail("call to dshm_sync() failed");
+	dshm_close(heap);
+
+	heap = dshm_open_file(path, 0);
+	if(heap == NULL)
+		fail("could not reopen the heap file");
+	check_list(heap);
+	dshm_close(heap);
+
+	/*
+	 * a child churns on the heap until it is killed, most likely with the
+	 * lock held and the free list half updated
+	 */
+	pid = fork();
+	if(pid < 0)
+		fail("fork failed");
+	if(pid == 0)
+	{
+		heap = dshm_open_file(path, 0);
+		if(heap == NULL)
+			_exit(1);
+		memset(junk, 0, sizeof(junk));
+		for(i = 0; ; i = (i + 1) % 64)
+		{
+			dshm_free(heap, junk[(i * 7) % 64]);
+			junk[(i * 7) % 64] = NULL;
+			dshm_free(heap, junk[i]);
+			junk[i] = dshm_alloc(heap, 16 + i * 24);
+		}
+	}
+	usleep(100000);
+	kill(pid, SIGKILL);
+	if(waitpid(pid, &status, 0) != pid || !WIFSIGNALED(status))
+		fail("the churning child did not run");
+
+	heap = dshm_open_file(path, 0);
+	if(heap == NULL)
+		fail("could not reopen the heap file after a crash");
+	check_list(heap);
+
+	/*
+	 * the free list was rebuilt: whatever the child held is leaked, but
+	 * everything else is free and coalesced again
+	 */
+	while((n = dshm_root(heap)) != NULL)
+	{
+		dshm_set_root(heap, dshm_pointer(heap, n->next));
+		dshm_free(heap, n);
+	}
+	if(dshm_alloc(heap, HEAP_SIZE / 2) == NULL)
+		fail("the free list was not rebuilt after the crash");
+	dshm_close(heap);
+
+	if(dshm_open_file("/dev/null", HEAP_SIZE) != NULL)
+		fail("dshm_open_file() accepted something that is not a heap file");
+	unlink(path);
+
+	printf("Persistent heap testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NSMALL 400
+#define NLARGE 100
+
+int main(int argc, char *argv[])
+{
+	void *small[NSMALL];
+	void *large[NLARGE];
+	size_t avg;
+	int i;
+
+	dmalloc_set_policy(DMM_POLICY_FIRST_FIT);
+
+	/*
+	 * fragment the front of the free list with blocks too small for the
+	 * requests below
+	 */
+	for(i = 0; i < NSMALL; i++)
+	{
+		small[i] = dmalloc(64);
+		if(small[i] == NULL)
+			fail("call to dmalloc() failed");
+	}
+	for(i = 0; i < NSMALL; i += 2)
+		dfree(small[i]);
+
+	for(i = 0; i < NLARGE / 2; i++)
+		large[i] = dmalloc(1000);
+
+	avg = dmalloc_search_average();
+	printf("first-fit search average: %zu\n", avg);
+	if(avg < NSMALL / 4)
+		fail("expected first-fit to walk past the small blocks");
+
+	/*
+	 * the adaptive policy should notice the long walks and move to bins
+	 */
+	dmalloc_set_policy(DMM_POLICY_ADAPTIVE);
+	for(; i < NLARGE; i++)
+		large[i] = dmalloc(1000);
+
+	avg = dmalloc_search_average();
+	printf("adaptive search average: %zu\n", avg);
+	if(avg > 8)
+		fail("adaptive policy did not shorten the search");
+
+	for(i = 0; i < NLARGE; i++)
+	{
+		if(large[i] == NULL)
+			fail("call to dmalloc() failed");
+		dfree(large[i]);
+	}
+	for(i = 1; i < NSMALL; i += 2)
+		dfree(small[i]);
+
+	/*
+	 * everything coalesced back, whichever lists the blocks were on
+	 */
+	large[0] = dmalloc(MAX_HEAP_SIZE / 2);
+	if(large[0] == NULL)
+		fail("heap did not coalesce back");
+	dfree(large[0]);
+
+	/*
+	 * address-ordered first-fit hands out the lowest free block, whatever
+	 * order the blocks were freed in
+	 */
+	dmalloc_set_policy(DMM_POLICY_ADDRESS_ORDERED);
+	for(i = 0; i < NSMALL; i++)
+	{
+		small[i] = dmalloc(64);
+		if(small[i] == NULL)
+			fail("call to dmalloc() failed");
+	}
+	for(i = 0; i < NSMALL / 4; i++)
+	{
+		/* pairs, since a block only fits requests that leave room to split */
+		dfree(small[(i * 37 % (NSMALL / 4)) * 4]);
+		dfree(small[(i * 37 % (NSMALL / 4)) * 4 + 1]);
+	}
+
+	for(i = 0; i < NSMALL; i += 4)
+	{
+		if(dmalloc(64) != small[i])
+			fail("address-ordered policy did not take the lowest block");
+	}
+	for(i = 0; i < NSMALL; i++)
+	{
+		if(i % 4 != 1) /* merged into the pair reused above */
+			dfree(small[i]);
+	}
+
+	large[0] = dmalloc(MAX_HEAP_SIZE / 2);
+	if(large[0] == NULL)
+		fail("heap did not coalesce back");
+	dfree(large[0]);
+
+	printf("Policy testcases passed!\n");
+	return(0);
+}
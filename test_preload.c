@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stddef.h> //for max_align_t
+#include <stdlib.h> //for exit
+#include <string.h>
+#include <malloc.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "test_util.h"
+
+/*
+ * Run with LD_PRELOAD=./libdmm.so; checks that the standard allocation
+ * functions are served by the heap manager and behave like malloc(3).
+ */
+
+#define NPTRS 1000
+
+static void free_stack_pointer(void)
+{
+	char buf[64];
+	char *volatile p = buf + 16; /* volatile keeps the compiler from seeing through it */
+
+	free(p);
+}
+
+int main(int argc, char *argv[])
+{
+	int (*owns)(void *) = (int (*)(void *))dlsym(RTLD_DEFAULT, "dmalloc_owns");
+	void *ptr[NPTRS];
+	char *s;
+	void *p;
+	int i, status;
+	size_t align;
+	pid_t pid;
+
+	if(owns == NULL)
+		fail("libdmm.so is not preloaded");
+
+	s = malloc(10);
+	if(s == NULL || !owns(s))
+		fail("malloc was not served by the heap manager");
+	strcpy(s, "aaaaaaaaa");
+
+	s = realloc(s, 1000);
+	if(s == NULL || strcmp(s, "aaaaaaaaa") != 0 || malloc_usable_size(s) < 1000)
+		fail("realloc lost the contents");
+	free(s);
+
+	s = calloc(100, 10);
+	if(((size_t)s & (_Alignof(max_align_t) - 1)) != 0)
+		fail("calloc returned a block misaligned for max_align_t");
+	for(i = 0; i < 1000; i++)
+	{
+		if(s[i] != 0)
+			fail("calloc memory is not zeroed");
+	}
+	free(s);
+
+	for(align = 16; align <= 4096; align *= 2)
+	{
+		if(posix_memalign(&p, align, 100) != 0 || ((size_t)p & (align - 1)) != 0 || !owns(p))
+			fail("posix_memalign returned a misaligned block");
+		memset(p, 'x', 100);
+		free(p);
+
+		p = aligned_alloc(align, 3 * align);
+		if(p == NULL || ((size_t)p & (align - 1)) != 0)
+			fail("aligned_alloc returned a misaligned block");
+		free(p);
+	}
+
+	if(malloc(0) == NULL)
+		fail("malloc(0) returned NULL");
+	align = (size_t)-1; /* through a variable to keep the compiler quiet */
+	if(malloc(align) != NULL)
+		fail("malloc(SIZE_MAX) succeeded");
+
+	for(i = 0; i < NPTRS; i++)
+	{
+		ptr[i] = malloc(1 + i * 37 % 5000);
+		if(ptr[i] == NULL)
+			fail("call to malloc() failed");
+		if(((size_t)ptr[i] & (_Alignof(max_align_t) - 1)) != 0)
+			fail("malloc returned a block misaligned for max_align_t");
+	}
+
+	/*
+	 * the child must be able to allocate after fork()
+	 */
+	pid = fork();
+	if(pid == 0)
+	{
+		s = strdup("child");
+		exit(s != NULL && owns(s) ? 0 : 1);
+	}
+	if(pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		fail("allocation in the forked child failed");
+
+	for(i = 0; i < NPTRS; i++)
+		free(ptr[i]);
+
+	/*
+	 * there is no other allocator behind us, so a foreign pointer is a bug
+	 */
+	expect_abort(free_stack_pointer, "free accepted a stack pointer");
+
+	printf("Preload testcases passed!\n");
+	return(0);
+}
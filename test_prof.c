@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit and setenv
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NPTRS 200
+#define NLIVE 3000 /* more than the profiler's initial table holds */
+
+extern char __start_dmm_frames[], __stop_dmm_frames[];
+
+/*
+ * reads the "heap profile: <objs>: <bytes> ..." header of a fresh dump, the
+ * frames of its first record and the innermost of them
+ */
+static void read_profile(size_t *objs, size_t *bytes, size_t *frames, void **top)
+{
+	FILE *f = tmpfile();
+	char line[4096];
+	char *p;
+	int dropped = 0;
+
+	if(f == NULL || !dmalloc_prof_dump(f))
+		fail("dmalloc_prof_dump() failed");
+	rewind(f);
+
+	if(fgets(line, sizeof(line), f) == NULL || sscanf(line, "heap profile: %zu: %zu", objs, bytes) != 2)
+		fail("malformed profile header");
+
+	*frames = 0;
+	*top = NULL;
+	while(fgets(line, sizeof(line), f) != NULL && line[0] == '#')
+		dropped = 1;
+	for(p = line; *p != '\0'; p++)
+	{
+		if(p[0] == '0' && p[1] == 'x')
+		{
+			if(*frames == 0)
+				*top = (void *)strtoull(p, NULL, 16);
+			(*frames)++;
+		}
+	}
+	fclose(f);
+
+	if(dropped)
+		fail("the profile dropped samples");
+}
+
+int main(int argc, char *argv[])
+{
+	static void *live[NLIVE];
+	void *ptr[NPTRS];
+	size_t objs, bytes, frames;
+	void *top;
+	dheap_t *heap;
+	int i;
+
+	/*
+	 * sample roughly every 256 bytes so that most of the allocations below
+	 * end up in the profile; the environment says the same for the first one
+	 */
+	setenv("DMALLOC_PROF_RATE", "256", 1);
+	dmalloc_prof_set_rate(256);
+
+	for(i = 0; i < NPTRS; i++)
+	{
+		ptr[i] = dmalloc(100 + i);
+		if(ptr[i] == NULL)
+			fail("call to dmalloc() failed");
+	}
+
+	read_profile(&objs, &bytes, &frames, &top);
+	printf("live samples after %d mallocs: %zu (%zu bytes)\n", NPTRS, objs, bytes);
+	if(objs == 0 || objs > NPTRS || frames == 0)
+		fail("expected sampled allocations with backtraces");
+
+	/*
+	 * the backtrace starts at this test's call, not inside the allocator
+	 */
+	if((char *)top >= __start_dmm_frames && (char *)top < __stop_dmm_frames)
+		fail("backtrace starts in the allocator");
+
+	/*
+	 * dfree must drop the records of the sampled blocks
+	 */
+	for(i = 0; i < NPTRS; i++)
+	{
+		dfree(ptr[i]);
+	}
+
+	read_profile(&objs, &bytes, &frames, &top);
+	printf("live samples after freeing: %zu (%zu bytes)\n", objs, bytes);
+	if(objs != 0 || bytes != 0)
+		fail("freed blocks are still in the profile");
+
+	/*
+	 * sampling nearly every allocation, the table has to grow rather than
+	 * drop samples
+	 */
+	dmalloc_prof_set_rate(1);
+	for(i = 0; i < NLIVE; i++)
+	{
+		live[i] = dmalloc(16);
+		if(live[i] == NULL)
+			fail("call to dmalloc() failed");
+	}
+	read_profile(&objs, &bytes, &frames, &top);
+	printf("live samples after %d small mallocs: %zu\n", NLIVE, objs);
+	if(objs < NLIVE / 2)
+		fail("expected most allocations in the profile");
+	for(i = 0; i < NLIVE; i++)
+	{
+		dfree(live[i]);
+	}
+	read_profile(&objs, &bytes, &frames, &top);
+	if(objs != 0)
+		fail("freed blocks are still in the profile after growing");
+
+	/*
+	 * with sampling off nothing gets recorded, and a new heap does not
+	 * bring back the rate from the environment
+	 */
+	dmalloc_prof_set_rate(0);
+	heap = dheap_create(1024 * 1024);
+	if(heap == NULL)
+		fail("dheap_create() failed");
+	dheap_free(heap, dheap_alloc(heap, 16));
+	dheap_destroy(heap);
+	ptr[0] = dmalloc(1000);
+	read_profile(&objs, &bytes, &frames, &top);
+	if(objs != 0)
+		fail("sample recorded while profiling is off");
+	dfree(ptr[0]);
+
+	printf("Profiler testcases passed!\n");
+	return(0);
+}
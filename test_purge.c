@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit and getenv
+#include <string.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define HUGE_PAGE (2UL*1024*1024)
+
+/*
+ * Purging must only touch free memory. Run once as is and once with
+ * DMALLOC_HUGEPAGES set, where the heap starts on a huge page boundary and
+ * only whole huge pages may be purged.
+ */
+
+static char *first = NULL;
+
+static void find_first(void *ptr, size_t size, bool used, void *arg)
+{
+	if(first == NULL)
+		first = (char*)ptr;
+}
+
+int main(int argc, char *argv[])
+{
+	char *huge = getenv("DMALLOC_HUGEPAGES");
+	char *keep, *gone;
+	size_t purged;
+	int i;
+
+	keep = dmalloc(1000);
+	gone = dmalloc(MAX_HEAP_SIZE / 2);
+	if(keep == NULL || gone == NULL)
+		fail("call to dmalloc() failed");
+	memset(keep, 'k', 1000);
+	memset(gone, 'g', MAX_HEAP_SIZE / 2);
+	dfree(gone);
+
+	purged = dmalloc_purge();
+	printf("purged %zu bytes\n", purged);
+
+	dmalloc_walk(find_first, NULL);
+
+	if(huge != NULL)
+	{
+		if(((size_t)first & (HUGE_PAGE - 1)) > 64 || purged % HUGE_PAGE != 0)
+			fail("huge page heap is misaligned or purged partial huge pages");
+	}
+	else if(purged == 0)
+		fail("nothing was purged");
+
+	for(i = 0; i < 1000; i++)
+	{
+		if(keep[i] != 'k')
+			fail("purge clobbered a used block");
+	}
+
+	/*
+	 * purged memory must still be usable
+	 */
+	gone = dmalloc(MAX_HEAP_SIZE / 2);
+	if(gone == NULL)
+		fail("dmalloc() after the purge failed");
+	memset(gone, 'g', MAX_HEAP_SIZE / 2);
+	dfree(gone);
+	dfree(keep);
+
+	printf("Purge testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit and setenv
+#include <string.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define QUARANTINE (64*1024)
+
+/*
+ * DMALLOC_QUARANTINE: freed blocks are not handed out again while in
+ * quarantine, a write to one is caught when it leaves, and the heap can
+ * still be used up completely.
+ */
+
+static void write_after_free(void)
+{
+	char *a = dmalloc(100);
+	int i;
+
+	dfree(a);
+	a[50] = 'x';
+	for(i = 0; i < 2 * QUARANTINE / 100; i++)
+		dfree(dmalloc(100));
+}
+
+int main(int argc, char *argv[])
+{
+	char *a, *b, *ptr[100];
+	int i;
+
+	setenv("DMALLOC_QUARANTINE", "65536", 1);
+
+	a = dmalloc(100);
+	dfree(a);
+	b = dmalloc(100);
+	if(b == a)
+		fail("a block in quarantine was handed out again");
+	if(((unsigned char *)a)[0] != 0xdb || ((unsigned char *)a)[99] != 0xdb)
+		fail("a block in quarantine was not poisoned");
+	dfree(b);
+
+	/*
+	 * churn far past the quarantine size; everything leaving it is checked
+	 */
+	for(i = 0; i < 20000; i++)
+	{
+		if(i >= 100)
+			dfree(ptr[i % 100]);
+		ptr[i % 100] = dmalloc(1 + i % 700);
+		if(ptr[i % 100] == NULL)
+			fail("call to dmalloc() failed");
+		memset(ptr[i % 100], 'a', 1 + i % 700);
+	}
+	for(i = 0; i < 100; i++)
+		dfree(ptr[i]);
+
+	expect_abort(write_after_free, "a write to a freed block went unnoticed");
+
+	/*
+	 * an allocation that needs the quarantined blocks empties the quarantine
+	 */
+	a = dmalloc(MAX_HEAP_SIZE / 2);
+	if(a == NULL)
+		fail("the quarantine kept the heap from being used up");
+	dfree(a);
+	if(dmalloc_quarantine_flush() == 0)
+		fail("the quarantine is not holding the last block");
+
+	printf("Quarantine testcases passed!\n");
+	return(0);
+}
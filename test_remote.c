@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <pthread.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NMSG 20000
+#define RING 64
+
+/*
+ * The main thread owns the heap and produces messages; a consumer thread
+ * frees them, which goes through the lock-free remote free path.
+ */
+
+static void *ring[RING];
+static unsigned long produced = 0, consumed = 0;
+
+static void *consumer(void *arg)
+{
+	while(__atomic_load_n(&consumed, __ATOMIC_RELAXED) < NMSG)
+	{
+		unsigned long c = consumed;
+		if(c == __atomic_load_n(&produced, __ATOMIC_ACQUIRE))
+			continue;
+		dfree(ring[c % RING]);
+		__atomic_store_n(&consumed, c + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t thread;
+	char *msg;
+	int i;
+
+	/*
+	 * the first dmalloc makes this thread the owner
+	 */
+	msg = dmalloc(16);
+	dfree(msg);
+
+	if(pthread_create(&thread, NULL, consumer, NULL) != 0)
+		fail("pthread_create failed");
+
+	for(i = 0; i < NMSG; i++)
+	{
+		while(produced - __atomic_load_n(&consumed, __ATOMIC_ACQUIRE) == RING)
+			;
+		msg = dmalloc(64 + (i % 7) * 100);
+		if(msg == NULL)
+			fail("call to dmalloc() failed at message %d", i);
+		msg[0] = (char)i;
+		ring[produced % RING] = msg;
+		__atomic_store_n(&produced, produced + 1, __ATOMIC_RELEASE);
+	}
+
+	pthread_join(thread, NULL);
+	printf("%d messages freed by the consumer thread\n", NMSG);
+
+	/*
+	 * draining the remote frees must leave one coalesced block behind
+	 */
+	msg = dmalloc(MAX_HEAP_SIZE / 2);
+	if(msg == NULL)
+		fail("remotely freed blocks were not returned to the heap");
+	dfree(msg);
+
+	printf("Remote free testcases passed!\n");
+	return(0);
+}
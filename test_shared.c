@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h> //for shm_unlink
+#include <sys/wait.h>
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define HEAP_SIZE (4*1024*1024)
+#define NCHILDREN 4
+#define NMSG 2000
+
+/*
+ * Shared heaps: forked children allocate in an anonymous shared heap at the
+ * same time and pass their messages to the parent as offsets; a named heap
+ * is attached by a second mapping at another address.
+ */
+
+static dshm_t *misused;
+
+static void double_free_shared(void)
+{
+	char *a = dshm_alloc(misused, 100);
+
+	dshm_free(misused, a);
+	dshm_free(misused, a);
+}
+
+static void free_misaligned_shared(void)
+{
+	dshm_free(misused, (char *)dshm_alloc(misused, 100) + 8);
+}
+
+static void child(dshm_t *heap, int id, int fd)
+{
+	char *keep[16];
+	int i, j;
+
+	for(i = 0; i < NMSG; i++)
+	{
+		/* churn on the shared lock, and send every 16th message */
+		for(j = 0; j < 16; j++)
+		{
+			keep[j] = dshm_alloc(heap, 32 + (i + j) % 200);
+			if(keep[j] == NULL)
+				_exit(2);
+			memset(keep[j], 'a' + id, 32);
+		}
+		for(j = 1; j < 16; j++)
+		{
+			if(keep[j][31] != 'a' + id)
+				_exit(3);
+			dshm_free(heap, keep[j]);
+		}
+		snprintf(keep[0], 32, "child %d message %d", id, i);
+		size_t off = dshm_offset(heap, keep[0]);
+		if(write(fd, &off, sizeof(off)) != sizeof(off))
+			_exit(4);
+	}
+	_exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	dshm_t *heap, *other;
+	int fds[2], status, i, id, n;
+	char expect[32], name[64], *msg, *big;
+	size_t off;
+	pid_t pid;
+
+	heap = dshm_create(NULL, HEAP_SIZE);
+	if(heap == NULL)
+		fail("call to dshm_create() failed");
+	if(pipe(fds) != 0)
+		fail("pipe failed");
+
+	for(id = 0; id < NCHILDREN; id++)
+	{
+		pid = fork();
+		if(pid < 0)
+			fail("fork failed");
+		if(pid == 0)
+		{
+			close(fds[0]);
+			child(heap, id, fds[1]);
+		}
+	}
+	close(fds[1]);
+
+	for(n = 0; read(fds[0], &off, sizeof(off)) == sizeof(off); n++)
+	{
+		msg = dshm_pointer(heap, off);
+		if(sscanf(msg, "child %d message %d", &id, &i) != 2 || id < 0 || id >= NCHILDREN)
+			fail("a message from a child was overwritten");
+		snprintf(expect, sizeof(expect), "child %d message %d", id, i);
+		if(strcmp(msg, expect) != 0)
+			fail("a message from a child was overwritten");
+		dshm_free(heap, msg);
+	}
+	for(id = 0; id < NCHILDREN; id++)
+	{
+		if(wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			fail("a child failed to allocate in the shared heap");
+	}
+	if(n != NCHILDREN * NMSG)
+		fail("messages went missing");
+
+	/*
+	 * every block came back and was coalesced
+	 */
+	big = dshm_alloc(heap, HEAP_SIZE / 2);
+	if(big == NULL)
+		fail("blocks freed by other processes were not coalesced");
+	dshm_free(heap, big);
+
+	/*
+	 * payloads are aligned as dmalloc's are, and bad frees are caught
+	 */
+	for(i = 1; i <= 100; i++)
+	{
+		msg = dshm_alloc(heap, i);
+		if(msg == NULL || (size_t)msg % DMALLOC_ALIGNMENT != 0)
+			fail("dshm_alloc(%d) returned a misaligned block", i);
+		dshm_free(heap, msg);
+	}
+	misused = heap;
+	expect_abort(double_free_shared, "a double free in a shared heap went unnoticed");
+	expect_abort(free_misaligned_shared, "dshm_free accepted a pointer into a block");
+	big = dshm_alloc(heap, HEAP_SIZE / 2);
+	if(big == NULL)
+		fail("the shared heap was not left intact");
+	dshm_free(heap, big);
+	dshm_close(heap);
+
+	/*
+	 * a named heap seen through two mappings
+	 */
+	snprintf(name, sizeof(name), "/dmm_test_shared.%d", (int)getpid());
+	heap = dshm_create(name, HEAP_SIZE);
+	other = dshm_open(name);
+	if(heap == NULL || other == NULL || (void *)heap == (void *)other)
+		fail("could not attach a named heap twice");
+	if(dshm_create(name, HEAP_SIZE) != NULL)
+		fail("dshm_create() reused an existing heap");
+	msg = dshm_alloc(heap, 100);
+	strcpy(msg, "hello");
+	if(strcmp(dshm_pointer(other, dshm_offset(heap, msg)), "hello") != 0)
+		fail("the second mapping does not see the block");
+	dshm_free(other, dshm_pointer(other, dshm_offset(heap, msg)));
+	big = dshm_alloc(heap, HEAP_SIZE - 4096);
+	if(big == NULL)
+		fail("a free through the second mapping was lost");
+	dshm_close(other);
+	dshm_close(heap);
+	shm_unlink(name);
+	if(dshm_open(name) != NULL)
+		fail("dshm_open() found an unlinked heap");
+
+	printf("Shared heap testcases passed!\n");
+	return(0);
+}
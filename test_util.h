@@ -0,0 +1,44 @@
+#ifndef __TEST_UTIL_H__
+#define __TEST_UTIL_H__
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h> //for exit
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+ * Helpers shared by the test programs.
+ */
+
+static void __attribute__((format(printf, 1, 2))) fail(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+/* runs misuse() in a child and expects it to die of SIGABRT; not every test needs it */
+static void __attribute__((unused)) expect_abort(void (*misuse)(void), const char *msg)
+{
+	int status;
+	pid_t pid = fork();
+
+	if(pid < 0)
+		fail("fork failed");
+	if(pid == 0)
+	{
+		close(STDERR_FILENO); /* the diagnostic is expected */
+		misuse();
+		_exit(0);
+	}
+	if(waitpid(pid, &status, 0) != pid || !WIFSIGNALED(status) || WTERMSIG(status) != SIGABRT)
+		fail("%s", msg);
+}
+
+#endif /* end of __TEST_UTIL_H__ */
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h> //for exit
+
+#include "dmm.h"
+#include "test_util.h"
+
+#define NPTRS 10
+
+struct walk_state {
+	int used;
+	int free;
+	size_t used_bytes;
+	char *last_ptr;
+	size_t last_size;
+	long overhead; /* gap between the end of one payload and the next */
+};
+
+static void count_block(void *ptr, size_t size, bool used, void *arg)
+{
+	struct walk_state *st = (struct walk_state*)arg;
+
+	printf("\t%p size %zu %s\n", ptr, size, used ? "used" : "free");
+
+	if(st->last_ptr != NULL)
+	{
+		long gap = (char*)ptr - (st->last_ptr + st->last_size);
+		if(gap <= 0 || (st->overhead != 0 && gap != st->overhead))
+			fail("blocks are not contiguous at %p", ptr);
+		st->overhead = gap;
+	}
+	st->last_ptr = (char*)ptr;
+	st->last_size = size;
+
+	if(used)
+	{
+		st->used++;
+		st->used_bytes += size;
+	}
+	else
+		st->free++;
+}
+
+static struct walk_state walk()
+{
+	struct walk_state st = {0, 0, 0, NULL, 0, 0};
+	dmalloc_walk(count_block, &st);
+	return st;
+}
+
+int main(int argc, char *argv[])
+{
+	void *ptr[NPTRS];
+	struct walk_state st;
+	int i;
+
+	for(i = 0; i < NPTRS; i++)
+	{
+		ptr[i] = dmalloc(64 * (i + 1));
+		if(ptr[i] == NULL)
+			fail("call to dmalloc() failed");
+	}
+
+	printf("walk after %d mallocs\n", NPTRS);
+	st = walk();
+	if(st.used != NPTRS || st.used_bytes < 64 * NPTRS * (NPTRS + 1) / 2 || st.free != 1)
+		fail("expected %d used blocks and the free remainder", NPTRS);
+
+	/*
+	 * free every other block; none of them are adjacent, so nothing coalesces
+	 */
+	for(i = 0; i < NPTRS; i += 2)
+		dfree(ptr[i]);
+
+	printf("walk after freeing every other block\n");
+	st = walk();
+	if(st.used != NPTRS / 2 || st.free != NPTRS / 2 + 1)
+		fail("unexpected block states after dfree");
+
+	for(i = 1; i < NPTRS; i += 2)
+		dfree(ptr[i]);
+
+	printf("walk after freeing everything\n");
+	st = walk();
+	if(st.used != 0 || st.free != 1)
+		fail("heap did not coalesce back into a single block");
+
+	printf("Heap walk testcases passed!\n");
+	return(0);
+}
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h> //for random, strtod and malloc of the harness state
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "workload.h"
+
+#define RAND() ((double)random()/RAND_MAX)
+
+/*
+    Defaults reproduce test_stress2: 50000 ops over 1000 slots, sizes uniform
+    below MAX_HEAP_SIZE/100, half of the ops allocating, random victims.
+*/
+void workload_defaults(workload_t* wl) {
+    wl->ops = 50000;
+    wl->slots = 1000;
+    wl->alloc_ratio = 0.5;
+    wl->seed = 1; // what random() uses when nobody seeds it
+    wl->max_size = MAX_HEAP_SIZE;
+    wl->size.shape = WL_UNIFORM;
+    wl->size.a = 0;
+    wl->size.b = MAX_HEAP_SIZE/100;
+    wl->size.c = 0;
+    wl->lifetime.shape = WL_RANDOM;
+    wl->lifetime.a = wl->lifetime.b = wl->lifetime.c = 0;
+    wl->alloc = dmalloc;
+    wl->release = dfree;
+}
+
+static const struct {
+    const char* name;
+    wl_shape_t shape;
+    int nparams;
+} shapes[] = {
+    {"uniform", WL_UNIFORM, 2},
+    {"lognormal", WL_LOGNORMAL, 2},
+    {"bimodal", WL_BIMODAL, 3},
+    {"powerlaw", WL_POWERLAW, 3},
+    {"exp", WL_EXP, 1},
+    {"fixed", WL_FIXED, 1},
+    {"random", WL_RANDOM, 0},
+};
+
+bool workload_parse_dist(const char* spec, wl_dist_t* dist) {
+
+    size_t len = strcspn(spec, ":");
+    double params[3] = {0, 0, 0};
+    int i, n;
+
+    for (i = 0; i < (int) (sizeof(shapes) / sizeof(shapes[0])); i++) {
+        if (strlen(shapes[i].name) == len && strncmp(spec, shapes[i].name, len) == 0) {
+            break;
+        }
+    }
+    if (i == (int) (sizeof(shapes) / sizeof(shapes[0]))) {
+        return false;
+    }
+
+    const char* p = spec + len;
+    for (n = 0; *p == ':' && n < 3; n++) {
+        char* end;
+        params[n] = strtod(p + 1, &end);
+        if (end == p + 1) {
+            return false;
+        }
+        p = end;
+    }
+    if (*p != '\0' || n != shapes[i].nparams) {
+        return false;
+    }
+
+    dist->shape = shapes[i].shape;
+    dist->a = params[0];
+    dist->b = params[1];
+    dist->c = params[2];
+    return true;
+}
+
+static double normal() {
+    // Box-Muller; 1 - RAND() keeps the log argument away from 0
+    double u1 = 1.0 - RAND();
+    double u2 = RAND();
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static double sample(const wl_dist_t* d) {
+    double u;
+
+    switch (d->shape) {
+    case WL_UNIFORM:
+        return d->a + RAND() * (d->b - d->a);
+    case WL_LOGNORMAL:
+        return exp(log(d->a) + d->b * normal());
+    case WL_BIMODAL:
+        u = (RAND() < d->c) ? d->a : d->b;
+        return u / 2 + RAND() * (u / 2);
+    case WL_POWERLAW:
+        // inverse CDF of a Pareto distribution truncated to [a, b]
+        u = RAND();
+        return d->a / pow(1.0 - u * (1.0 - pow(d->a / d->b, d->c)), 1.0 / d->c);
+    case WL_EXP:
+        return -log(1.0 - RAND()) * d->a;
+    case WL_FIXED:
+        return d->a;
+    case WL_RANDOM:
+        break;
+    }
+    return 0;
+}
+
+int workload_parse_arg(workload_t* wl, int argc, char* argv[], int i) {
+
+    const char* opt = argv[i];
+    const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+    char* end = NULL;
+
+    if (strcmp(opt, "--random-seed") == 0) {
+        wl->seed = (unsigned int) time(NULL);
+        return 1;
+    }
+
+    if (strcmp(opt, "--ops") != 0 && strcmp(opt, "--slots") != 0 && strcmp(opt, "--ratio") != 0
+        && strcmp(opt, "--seed") != 0 && strcmp(opt, "--max-size") != 0
+        && strcmp(opt, "--size") != 0 && strcmp(opt, "--lifetime") != 0) {
+        return 0;
+    }
+    if (val == NULL) {
+        return -1;
+    }
+
+    if (strcmp(opt, "--size") == 0) {
+        return workload_parse_dist(val, &wl->size) && wl->size.shape != WL_RANDOM ? 2 : -1;
+    }
+    if (strcmp(opt, "--lifetime") == 0) {
+        return workload_parse_dist(val, &wl->lifetime) ? 2 : -1;
+    }
+
+    if (strcmp(opt, "--ratio") == 0) {
+        wl->alloc_ratio = strtod(val, &end);
+    } else {
+        long long n = strtoll(val, &end, 10);
+        if (n <= 0 && strcmp(opt, "--seed") != 0) {
+            return -1;
+        }
+        if (strcmp(opt, "--ops") == 0) {
+            wl->ops = n;
+        } else if (strcmp(opt, "--slots") == 0) {
+            wl->slots = (int) n;
+        } else if (strcmp(opt, "--seed") == 0) {
+            wl->seed = (unsigned int) n;
+        } else {
+            wl->max_size = (size_t) n;
+        }
+    }
+
+    return (*end == '\0') ? 2 : -1;
+}
+
+void workload_usage(FILE* out) {
+    fprintf(out,
+        "  --ops N            number of ops (50000)\n"
+        "  --slots N          live object slots (1000)\n"
+        "  --ratio P          probability that an op allocates (0.5)\n"
+        "  --seed N           random seed (1); --random-seed seeds from the clock\n"
+        "  --max-size N       clamp sampled sizes to N bytes (MAX_HEAP_SIZE)\n"
+        "  --size SPEC        size distribution (uniform:0:%d)\n"
+        "  --lifetime SPEC    lifetime in ops, or random victims (random)\n"
+        "  SPEC is uniform:MIN:MAX, lognormal:MEDIAN:SIGMA, bimodal:SMALL:LARGE:P,\n"
+        "  powerlaw:MIN:MAX:ALPHA, exp:MEAN or fixed:N\n", MAX_HEAP_SIZE/100);
+}
+
+/*
+    Objects with a lifetime sit in a binary min-heap ordered by the op at
+    which they die, so expiring them costs O(log slots) per object.
+*/
+typedef struct expiry {
+    long when;
+    int slot;
+} expiry_t;
+
+static void expiry_push(expiry_t* heap, int* n, long when, int slot) {
+    int i = (*n)++;
+
+    while (i > 0 && heap[(i - 1) / 2].when > when) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i].when = when;
+    heap[i].slot = slot;
+}
+
+static expiry_t expiry_pop(expiry_t* heap, int* n) {
+    expiry_t top = heap[0];
+    expiry_t last = heap[--(*n)];
+    int i = 0;
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= *n) {
+            break;
+        }
+        if (child + 1 < *n && heap[child + 1].when < heap[child].when) {
+            child++;
+        }
+        if (heap[child].when >= last.when) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+bool workload_run(const workload_t* wl, wl_result_t* result) {
+
+    void** ptr = calloc(wl->slots, sizeof(void*));
+    size_t* sizes = calloc(wl->slots, sizeof(size_t));
+    expiry_t* expiries = calloc(wl->slots, sizeof(expiry_t));
+    int nexpiries = 0;
+    bool timed = (wl->lifetime.shape != WL_RANDOM);
+    size_t live_bytes = 0;
+    clock_t begin, end;
+    long i;
+    int itr;
+
+    if (ptr == NULL || sizes == NULL || expiries == NULL) {
+        free(ptr);
+        free(sizes);
+        free(expiries);
+        return false;
+    }
+
+    memset(result, 0, sizeof(*result));
+    srandom(wl->seed);
+
+    begin = clock();
+
+    for (i = 0; i < wl->ops; i++) {
+
+        while (nexpiries > 0 && expiries[0].when <= i) {
+            itr = expiry_pop(expiries, &nexpiries).slot;
+            wl->release(ptr[itr]);
+            live_bytes -= sizes[itr];
+            ptr[itr] = NULL;
+            result->frees++;
+        }
+
+        itr = (int) (RAND() * wl->slots);
+        if (itr >= wl->slots) {
+            itr = wl->slots - 1;
+        }
+
+        double randvar = RAND();
+
+        if (randvar < wl->alloc_ratio && ptr[itr] == NULL) {
+            double s = sample(&wl->size);
+            size_t size = (s < 0) ? 0 : (s > wl->max_size) ? wl->max_size : (size_t) s;
+
+            if (size == 0) {
+                continue;
+            }
+
+            ptr[itr] = wl->alloc(size);
+            if (ptr[itr] == NULL) {
+                result->fails++;
+                continue;
+            }
+
+            result->allocs++;
+            sizes[itr] = size;
+            live_bytes += size;
+            if (live_bytes > result->peak_bytes) {
+                result->peak_bytes = live_bytes;
+            }
+
+            if (timed) {
+                double life = sample(&wl->lifetime);
+                expiry_push(expiries, &nexpiries, i + 1 + (life > 0 ? (long) life : 0), itr);
+            }
+        } else if (!timed && randvar >= wl->alloc_ratio && ptr[itr] != NULL) {
+            wl->release(ptr[itr]);
+            live_bytes -= sizes[itr];
+            ptr[itr] = NULL;
+            result->frees++;
+        }
+    }
+
+    for (itr = 0; itr < wl->slots; itr++) {
+        if (ptr[itr] != NULL) {
+            wl->release(ptr[itr]);
+            ptr[itr] = NULL;
+            result->frees++;
+        }
+    }
+
+    end = clock();
+    result->seconds = (double) (end - begin) / CLOCKS_PER_SEC;
+
+    free(ptr);
+    free(sizes);
+    free(expiries);
+    return true;
+}
+
+/*
+    Prints the same summary line as the stress tests, where every op that is
+    not a failed allocation counts as successful.
+*/
+void workload_print(FILE* out, const workload_t* wl, const wl_result_t* result) {
+    fprintf(out, "Loop count: %ld, malloc successful: %ld, malloc failed: %ld, execution time: %g seconds\n",
+            wl->ops, wl->ops - result->fails, result->fails, result->seconds);
+    fprintf(out, "allocations: %ld, frees: %ld, peak live bytes: %zu\n",
+            result->allocs, result->frees, result->peak_bytes);
+}
@@ -0,0 +1,63 @@
+#ifndef __DMM_WORKLOAD_H__
+#define __DMM_WORKLOAD_H__
+
+#include "dmm.h"
+
+/*
+    Deterministic workload generator for allocator benchmarks.
+
+    A workload is a sequence of ops over a fixed number of slots. The default
+    settings replay test_stress2 exactly: each op picks a random slot and, with
+    probability alloc_ratio, allocates into it if it is empty, otherwise frees
+    it if it is occupied. Sizes and lifetimes come from configurable
+    distributions; with a lifetime distribution other than "random", objects
+    are instead freed once they have lived for the sampled number of ops.
+
+    Distributions are written as shape:param:param..., e.g.
+        uniform:MIN:MAX          MIN + U[0,1) * (MAX - MIN)
+        lognormal:MEDIAN:SIGMA   exp(ln(MEDIAN) + SIGMA * N(0,1))
+        bimodal:SMALL:LARGE:P    U[SMALL/2, SMALL] with probability P, else U[LARGE/2, LARGE]
+        powerlaw:MIN:MAX:ALPHA   bounded Pareto with tail index ALPHA
+        exp:MEAN                 exponential
+        fixed:N                  always N
+        random                   lifetimes only: free a random victim (test_stress2)
+
+    Sizes that come out as 0 skip the op, as the stress tests do. The
+    generator draws from random(), so a given seed replays the same sequence.
+*/
+
+typedef enum {WL_UNIFORM, WL_LOGNORMAL, WL_BIMODAL, WL_POWERLAW, WL_EXP, WL_FIXED, WL_RANDOM} wl_shape_t;
+
+typedef struct wl_dist {
+    wl_shape_t shape;
+    double a, b, c;
+} wl_dist_t;
+
+typedef struct workload {
+    long ops;
+    int slots;
+    double alloc_ratio; // probability that an op tries to allocate
+    unsigned int seed;
+    size_t max_size; // sizes are clamped to this
+    wl_dist_t size;
+    wl_dist_t lifetime; // in ops
+    void* (*alloc)(size_t numbytes); // dmalloc unless set otherwise
+    void (*release)(void* ptr); // dfree unless set otherwise
+} workload_t;
+
+typedef struct wl_result {
+    long allocs; // successful allocations
+    long fails;
+    long frees;
+    size_t peak_bytes; // most requested bytes live at once
+    double seconds;
+} wl_result_t;
+
+void workload_defaults(workload_t* wl);
+bool workload_parse_dist(const char* spec, wl_dist_t* dist);
+int workload_parse_arg(workload_t* wl, int argc, char* argv[], int i); // args consumed at argv[i], 0 if not ours, -1 if malformed
+void workload_usage(FILE* out);
+bool workload_run(const workload_t* wl, wl_result_t* result);
+void workload_print(FILE* out, const workload_t* wl, const wl_result_t* result);
+
+#endif /* end of __DMM_WORKLOAD_H__ */